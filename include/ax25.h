@@ -18,15 +18,96 @@
 
 #define AX25_MAX_ADDR_LEN 28
 #define AX25_MIN_ADDR_LEN 14
+#define AX25_ADDR_LEN 7 /* one address: callsign and SSID byte */
+#define AX25_MAX_DIGIS ((AX25_MAX_ADDR_LEN - AX25_MIN_ADDR_LEN) / AX25_ADDR_LEN)
+
+/* Bit of a digipeater SSID byte set once it has repeated the frame */
+#define AX25_ADDR_H_BIT 0x80
 
 #define AX25_MIN_CTRL_LEN 1
 #define AX25_MAX_CTRL_LEN 2
 #define AX25_CALLSIGN_MAX_LEN 6
 #define AX25_CALLSIGN_MIN_LEN 2
 
+/* Bytes between two flags: address, control, PID, info and FCS */
+#define AX25_MIN_RAW_FRAME_LEN (AX25_MIN_ADDR_LEN + AX25_MIN_CTRL_LEN + 2)
+#define AX25_MAX_RAW_FRAME_LEN (AX25_MAX_ADDR_LEN + AX25_MAX_CTRL_LEN + 1 + AX25_MAX_FRAME_LEN + 2)
+
+/*
+ * Worst case size of an encoded frame: the line sync flags, both flags
+ * plus the frame with a stuffed bit after every five bits
+ */
+#define AX25_ENCODED_SIZE_MAX(info_len) \
+  ((8 * AX25_LINE_SYNC_MAX + 16 + (AX25_MAX_ADDR_LEN + AX25_MAX_CTRL_LEN + 1 + (info_len) + 2) * 8 * 6 / 5 + 7) / 8)
+#define AX25_MAX_ENCODED_LEN AX25_ENCODED_SIZE_MAX(AX25_MAX_FRAME_LEN)
+
 #define AX25_PREAMBLE_LEN 16
 #define AX25_POSTAMBLE_LEN 16
 
+/**
+ * FCS backends, selected at build time with AX25_FCS_BACKEND
+ */
+#define AX25_FCS_TABLE  0 //!< single 256 entry table, one byte per step
+#define AX25_FCS_SLICE4 1 //!< slicing-by-4 tables
+#define AX25_FCS_SLICE8 2 //!< slicing-by-8 tables
+#define AX25_FCS_CLMUL  3 //!< PCLMULQDQ (detected at run time) or ARMv8 PMULL, else slicing-by-8
+#define AX25_FCS_STM32  4 //!< STM32 CRC peripheral with programmable polynomial
+
+#ifndef AX25_FCS_BACKEND
+#if defined(__x86_64__) || defined(__i386__) || defined(__aarch64__)
+#define AX25_FCS_BACKEND AX25_FCS_CLMUL
+#else
+#define AX25_FCS_BACKEND AX25_FCS_SLICE8
+#endif
+#endif
+
+/**
+ * Flag scanner backends, selected at build time with AX25_SCAN_BACKEND
+ */
+#define AX25_SCAN_SCALAR 0 //!< one byte per step, portable
+#define AX25_SCAN_SIMD   1 //!< SSE2/AVX2 (detected at run time) or NEON, else scalar
+
+#ifndef AX25_SCAN_BACKEND
+#if defined(__x86_64__) || defined(__i386__) || defined(__aarch64__)
+#define AX25_SCAN_BACKEND AX25_SCAN_SIMD
+#else
+#define AX25_SCAN_BACKEND AX25_SCAN_SCALAR
+#endif
+#endif
+
+/**
+ * x86 features picked at run time by the CLMUL and SIMD backends, see
+ * ax25_cpu_features()
+ */
+#define AX25_CPU_PCLMUL 0x01
+#define AX25_CPU_AVX2   0x02
+
+/*
+ * Build ax25_encode() on the constant prefix of include/ax25_fixed.h, so
+ * only the info field and the FCS are processed per frame. The header must
+ * be regenerated with tools/ax25_gen_fixed.c when config.h changes.
+ */
+#ifndef AX25_FIXED_PREFIX
+#define AX25_FIXED_PREFIX 0
+#endif
+
+/*
+ * Receive diagnostics counters and cycle counts of the encode and decode
+ * stages, see include/ax25_prof.h. Both compile to nothing when 0.
+ */
+#ifndef AX25_STATS
+#define AX25_STATS 1
+#endif
+
+#ifndef AX25_PROF
+#define AX25_PROF 0
+#endif
+
+/* CMSIS device header providing the CRC registers */
+#ifndef AX25_STM32_CMSIS_HEADER
+#define AX25_STM32_CMSIS_HEADER "stm32l4xx.h"
+#endif
+
 /* AX.25 flag */
 #define AX25_FLAG 0x7E
 
@@ -43,11 +124,54 @@ typedef enum
 
 
 /**
- * AX.25 control fields
- * FUTURE_SHASH_PROBLEMS : need to add for other frame types
+ * AX.25 control fields, without the P/F bit. I and S frames also carry
+ * sequence numbers, see ax25_ctrl_i() and ax25_ctrl_s().
 */
 
 static const uint8_t AX25_CTRL_UI= 0x03;
+static const uint8_t AX25_CTRL_SABM = 0x2F;
+static const uint8_t AX25_CTRL_SABME = 0x6F;
+static const uint8_t AX25_CTRL_DISC = 0x43;
+static const uint8_t AX25_CTRL_DM = 0x0F;
+static const uint8_t AX25_CTRL_UA = 0x63;
+static const uint8_t AX25_CTRL_FRMR = 0x87;
+static const uint8_t AX25_CTRL_RR = 0x01;
+static const uint8_t AX25_CTRL_RNR = 0x05;
+static const uint8_t AX25_CTRL_REJ = 0x09;
+static const uint8_t AX25_CTRL_SREJ = 0x0D;
+
+/* P/F bit of one byte control fields, and of the second byte of modulo 128 ones */
+#define AX25_CTRL_PF     0x10
+#define AX25_CTRL_PF_EXT 0x01
+
+/**
+ * Line coding applied on top of the stuffed bitstream. When both are
+ * selected, NRZI is applied first on TX and undone last on RX.
+ */
+#define AX25_LINE_NONE  0x00
+#define AX25_LINE_NRZI  0x01 //!< NRZI, a 0 is sent as a level transition
+#define AX25_LINE_G3RUH 0x02 //!< G3RUH x^17 + x^12 + 1 scrambler for 9600 baud
+
+/*
+ * Flags sent before the opening flag when the line coder starts from its
+ * reset state, so a receiver joining mid-stream decodes the opening flag:
+ * the NRZI decoder needs one bit, the descrambler 17
+ */
+#define AX25_LINE_SYNC_FLAGS(line) \
+  (((line) & AX25_LINE_G3RUH) ? 3 : ((line) & AX25_LINE_NRZI) ? 1 : 0)
+#define AX25_LINE_SYNC_MAX 3
+
+/**
+ * Line coder of a transmitter. The NRZI level and the scrambler register
+ * run on from one frame to the next, so a receiver that locked on a frame
+ * stays locked on the following ones.
+ */
+typedef struct
+{
+  uint8_t line;         //!< AX25_LINE_xxx coding applied
+  uint8_t nrzi_level;   //!< last NRZI line level
+  uint32_t lfsr;        //!< scrambler register
+} ax25_line_coder_t;
 
 /**
  * bit stuffing status
@@ -63,23 +187,340 @@ typedef enum
   AX25_DEC_FAIL, AX25_DEC_OK
 } ax25_decode_status_t;
 
+/**
+ * Fields of a received frame, see ax25_parse_ctrl()
+ */
+typedef struct
+{
+  ax25_frame_type_t type;   //!< I, S, U or UI
+  uint8_t code;             //!< AX25_CTRL_xxx of S and U frames
+  uint8_t ns;               //!< N(S) of I frames
+  uint8_t nr;               //!< N(R) of I and S frames
+  uint8_t pf;               //!< the P/F bit
+  uint8_t command;          //!< 1 for a command, 0 for a response
+  size_t addr_len;          //!< length of the address field
+  size_t info_off;          //!< start of the info field, after the control and PID
+} ax25_ctrl_info_t;
+
+/**
+ * A digipeater of the path of a frame
+ */
+typedef struct
+{
+  const uint8_t *call;  //!< callsign, up to 6 characters
+  uint8_t ssid;
+} ax25_digi_t;
+
+/**
+ * Address field of a received frame. The addresses point into the frame,
+ * AX25_ADDR_LEN bytes each.
+ */
+typedef struct
+{
+  const uint8_t *dest;
+  const uint8_t *src;
+  const uint8_t *digi[AX25_MAX_DIGIS];  //!< digipeaters, in path order
+  size_t ndigis;
+  size_t next_digi;                     //!< first digipeater without the H bit, ndigis if none
+  size_t len;                           //!< length of the address field
+} ax25_addr_path_t;
+
+/* SSID of an address of a received frame */
+#define AX25_ADDR_SSID(addr) (((addr)[AX25_ADDR_LEN - 1] >> 1) & 0x0F)
+
+/**
+ * A decoded frame, split in place by ax25_parse_frame(). Every pointer is
+ * into the frame, which must outlive the view. Callsigns are left shifted
+ * as received; ax25_addr_call() decodes them on demand.
+ */
+typedef struct
+{
+  const uint8_t *frame;   //!< the frame without the FCS
+  size_t len;             //!< length of frame
+  ax25_addr_path_t path;  //!< the address entries
+  ax25_ctrl_info_t ctrl;  //!< frame type, sequence numbers and P/F bit
+  const uint8_t *pid;     //!< PID of I and UI frames, NULL otherwise
+  const uint8_t *info;    //!< the info field, may be empty
+  size_t info_len;
+} ax25_frame_view_t;
+
+/**
+ * A segment of a scattered info field
+ */
+typedef struct
+{
+  const uint8_t *base;  //!< segment data
+  size_t len;           //!< segment length
+} ax25_iovec_t;
+
+/**
+ * Encoder context. Holds the address field, already shifted, and the FCS
+ * register after it, so frames only hash their control, PID and info.
+ */
+typedef struct
+{
+  uint8_t addr[AX25_MAX_ADDR_LEN];  //!< address field
+  size_t addr_len;                  //!< length of addr
+  uint16_t addr_fcs;                //!< FCS register after the address field
+  uint8_t line;                     //!< AX25_LINE_xxx coding of the output
+} ax25_enc_ctx_t;
+
+/**
+ * Bit stuffing engine state. Stuffed bits are packed MSB first, in
+ * transmission order, directly into the output bitstream.
+ */
+typedef struct
+{
+  uint8_t *out;       //!< output bitstream
+  size_t out_cap;     //!< size of out in bytes
+  size_t out_idx;     //!< number of whole bytes written to out
+  uint32_t acc;       //!< bits not yet written to out, LSB is the latest
+  uint8_t acc_bits;   //!< number of valid bits in acc
+  uint8_t cont_1;     //!< length of the current run of 1's
+  ax25_line_coder_t coder;  //!< line coding applied to every output byte
+} ax25_stuffer_t;
+
+/* Maximum number of info segments of a frame sent with ax25_tx_start() */
+#define AX25_TX_MAX_IOV 8
+
+typedef enum
+{
+  AX25_TX_PREAMBLE, AX25_TX_BODY, AX25_TX_POSTAMBLE, AX25_TX_DONE
+} ax25_tx_state_t;
+
+struct ax25_tx;
+
+/**
+ * Called by the transmitter once the body of a frame is stuffed
+ * @param user the opaque pointer set in tx->source_user
+ * @param tx the transmitter. The next frame is set up with ax25_tx_load()
+ * @return AX25_ENC_OK if a frame was loaded, AX25_ENC_FAIL to end the
+ * transmission
+ */
+typedef ax25_encode_status_t (*ax25_tx_source_t)(void *user, struct ax25_tx *tx);
+
+/**
+ * Pull-style transmitter. Produces the stuffed bitstream of a frame, with
+ * its preamble and postamble, a chunk at a time. Frames supplied by the
+ * source callback are sent back to back, separated by a single flag.
+ */
+typedef struct ax25_tx
+{
+  ax25_stuffer_t s;                           //!< stuffer, writing into the current chunk
+  ax25_iovec_t parts[AX25_TX_MAX_IOV + 3];    //!< address, control/PID, info segments, FCS
+  size_t nparts;                              //!< number of entries in parts
+  size_t part;                                //!< part being sent
+  size_t part_off;                            //!< bytes of the part already sent
+  uint8_t hdr[AX25_MAX_CTRL_LEN + 1];         //!< control and PID fields
+  uint8_t fcs_field[sizeof(uint16_t)];        //!< FCS, once the info is hashed
+  uint16_t fcs;                               //!< FCS register
+  uint16_t preamble_len;                      //!< flags sent before the frame
+  uint16_t postamble_len;                     //!< flags sent after the frame
+  uint16_t flags_sent;                        //!< flags of the current preamble/postamble
+  ax25_tx_source_t source;                    //!< supplies the following frames, or NULL
+  void *source_user;                          //!< opaque pointer passed to source
+  ax25_tx_state_t state;
+} ax25_tx_t;
+
+/*
+ * Bytes of a frame given to the deframer header hook: the address field
+ * and, for frames without digipeaters, the control and PID bytes
+ */
+#define AX25_DF_HDR_LEN (AX25_MIN_ADDR_LEN + 2)
+
+/**
+ * Called by the deframer once the first AX25_DF_HDR_LEN bytes of a frame
+ * are destuffed, before anything else is stored or hashed
+ * @param user the opaque pointer d->hdr_user
+ * @param hdr the bytes received
+ * @return the buffer receiving the rest of the frame, of d->out_cap bytes
+ * and starting with a copy of hdr (or hdr itself), or NULL to skip the
+ * frame up to the next flag
+ */
+typedef uint8_t *(*ax25_deframer_hdr_cb_t)(void *user, uint8_t *hdr);
+
+/**
+ * HDLC deframer state. The received bitstream is destuffed a byte at a time
+ * with precomputed transition tables.
+ */
+typedef struct
+{
+  uint8_t *out;         //!< buffer receiving the destuffed frame
+  size_t out_cap;       //!< size of out in bytes
+  size_t out_len;       //!< bytes of the current frame, FCS included
+  size_t fcs_len;       //!< bytes of out already added to fcs
+  uint16_t fcs;         //!< FCS register, the computed FCS once complete
+  uint16_t acc;         //!< destuffed bits of the next byte, LSB first
+  uint8_t acc_bits;     //!< number of valid bits in acc
+  uint8_t cont_1;       //!< run of 1's on the line
+  uint8_t in_frame;     //!< a flag was seen and a frame is being received
+  uint8_t flag_seen;    //!< at least one flag was seen
+  uint8_t frame_ready;  //!< a complete frame is held in out
+  uint8_t fcs_ok;       //!< the FCS of the complete frame matches
+  uint8_t rem;          //!< input bits left after the frame end, MSB first
+  uint8_t rem_bits;     //!< number of bits in rem
+  uint8_t line;         //!< AX25_LINE_xxx decoding of the input
+  uint8_t nrzi_level;   //!< last NRZI line level
+  uint32_t lfsr;        //!< descrambler register
+  ax25_deframer_hdr_cb_t on_hdr;  //!< checks the header of every frame, or NULL
+  void *hdr_user;       //!< opaque pointer passed to on_hdr
+} ax25_deframer_t;
+
+/**
+ * Describes a frame found by ax25_decode_batch()
+ */
+typedef struct
+{
+  size_t offset;                //!< start of the frame in the arena
+  size_t len;                   //!< length of the frame without the FCS
+  size_t in_offset;             //!< input byte holding the end of the closing flag
+  ax25_decode_status_t status;  //!< AX25_DEC_OK if the FCS matches
+} ax25_frame_desc_t;
+
+/* Least reliable bits a soft recovery may flip */
+#define AX25_RECOVER_MAX_FLIPS 16
+
+/**
+ * FCS recovery settings. Every flip pattern tried is another chance to
+ * accept a frame that is damaged beyond repair: each one passes a random
+ * frame with a probability of 1/65536. Keep the budget small, or check the
+ * contents of recovered frames at a higher layer.
+ */
+typedef struct
+{
+  uint8_t max_flips;    //!< least reliable bits combined, 0 to AX25_RECOVER_MAX_FLIPS
+  uint8_t single_bit;   //!< also try flipping each bit alone, needs no confidences
+  uint32_t budget;      //!< maximum number of flip patterns tested
+} ax25_recover_cfg_t;
+
+/**
+ * Called by the streaming receiver for every decoded frame
+ * @param user the opaque pointer given to ax25_rx_init()
+ * @param frame the frame without the FCS. Valid only during the call
+ * @param len length of frame
+ */
+typedef void (*ax25_rx_frame_cb_t)(void *user, const uint8_t *frame, size_t len);
+
+/**
+ * Streaming receiver. Keeps the deframer state and the frame under
+ * construction between calls, so input can be pushed in arbitrary chunks.
+ */
+typedef struct
+{
+  ax25_deframer_t deframer;
+  uint8_t frame[AX25_MAX_RAW_FRAME_LEN];
+  const ax25_recover_cfg_t *recover;  //!< single bit recovery of bad frames, or NULL
+  ax25_rx_frame_cb_t on_frame;
+  void *user;
+} ax25_rx_ctx_t;
+
 /**
  * function definitions
 */
 
 size_t ax25_create_addr_field(uint8_t *out, const uint8_t *dest_addr, uint8_t dest_ssid,const uint8_t *src_addr, uint8_t src_ssid);
 
-uint16_t ax25_fcs(uint8_t *buffer, size_t len);
+size_t ax25_create_addr_path(uint8_t *out, const uint8_t *dest_addr, uint8_t dest_ssid, const uint8_t *src_addr, uint8_t src_ssid, const ax25_digi_t *digis, size_t ndigis);
+
+int ax25_addr_match(const uint8_t *addr, const uint8_t *call, uint8_t ssid);
+
+uint32_t ax25_cpu_features(void);
+
+uint16_t ax25_fcs_update(uint16_t fcs, const uint8_t *buffer, size_t len);
+
+uint16_t ax25_fcs(const uint8_t *buffer, size_t len);
+
+uint16_t ax25_fcs_shift(uint16_t fcs, size_t len);
 
 size_t ax25_create_frame(uint8_t *out, const uint8_t *info, size_t info_len, ax25_frame_type_t type, uint8_t *addr, size_t addr_len, uint16_t ctrl, size_t ctrl_len);
 
+void ax25_enc_init(ax25_enc_ctx_t *ctx, const uint8_t *dest_addr, uint8_t dest_ssid, const uint8_t *src_addr, uint8_t src_ssid);
+
+ax25_encode_status_t ax25_enc_init_path(ax25_enc_ctx_t *ctx, const uint8_t *dest_addr, uint8_t dest_ssid, const uint8_t *src_addr, uint8_t src_ssid, const ax25_digi_t *digis, size_t ndigis);
+
+void ax25_enc_set_line_coding(ax25_enc_ctx_t *ctx, uint8_t line);
+
+void ax25_stuffer_init(ax25_stuffer_t *s, uint8_t *out, size_t out_cap);
+
+ax25_encode_status_t ax25_stuffer_put_flag(ax25_stuffer_t *s);
+
+ax25_encode_status_t ax25_stuffer_open(ax25_stuffer_t *s, uint8_t line);
+
+ax25_encode_status_t ax25_stuffer_put(ax25_stuffer_t *s, const uint8_t *buffer, size_t len);
+
+ax25_encode_status_t ax25_stuffer_finish(ax25_stuffer_t *s, size_t *out_bits);
+
+ax25_encode_status_t ax25_stuffer_put_frame(ax25_stuffer_t *s, const uint8_t *frame, size_t len);
+
+void ax25_line_init(ax25_line_coder_t *coder, uint8_t line);
+
+void ax25_line_code(ax25_line_coder_t *coder, uint8_t *out, const uint8_t *in, size_t len);
+
+size_t ax25_encoded_size_max(size_t info_len);
+
+int32_t ax25_encode_iov(const ax25_enc_ctx_t *ctx, uint8_t *out, size_t out_cap, const ax25_iovec_t *iov, size_t iovcnt, ax25_frame_type_t type);
+
+uint16_t ax25_ctrl_i(uint8_t ns, uint8_t nr, uint8_t pf, uint8_t mod128, size_t *ctrl_len);
+
+uint16_t ax25_ctrl_s(uint8_t code, uint8_t nr, uint8_t pf, uint8_t mod128, size_t *ctrl_len);
+
+uint16_t ax25_ctrl_u(uint8_t code, uint8_t pf, size_t *ctrl_len);
+
+int32_t ax25_encode_ctrl_iov(const ax25_enc_ctx_t *ctx, uint8_t *out, size_t out_cap, uint16_t ctrl, size_t ctrl_len, const ax25_iovec_t *iov, size_t iovcnt);
+
+int32_t ax25_encode_raw(uint8_t *out, size_t out_cap, const uint8_t *frame, size_t len, uint8_t line);
+
+ax25_decode_status_t ax25_parse_addr(const uint8_t *frame, size_t len, ax25_addr_path_t *path);
+
+ax25_decode_status_t ax25_parse_ctrl(const uint8_t *frame, size_t len, uint8_t mod128, ax25_ctrl_info_t *info);
+
+ax25_decode_status_t ax25_parse_frame(const uint8_t *frame, size_t len, uint8_t mod128, ax25_frame_view_t *view);
+
+size_t ax25_addr_call(const uint8_t *addr, char *call);
+
+int32_t ax25_encode_into(const ax25_enc_ctx_t *ctx, uint8_t *out, size_t out_cap, const uint8_t *in, size_t inlen, ax25_frame_type_t type);
+
+ax25_encode_status_t ax25_tx_start(ax25_tx_t *tx, const ax25_enc_ctx_t *ctx, const ax25_iovec_t *iov, size_t iovcnt, ax25_frame_type_t type);
+
+ax25_encode_status_t ax25_tx_load(ax25_tx_t *tx, const ax25_enc_ctx_t *ctx, const ax25_iovec_t *iov, size_t iovcnt, ax25_frame_type_t type);
+
+size_t ax25_tx_next_chunk(ax25_tx_t *tx, uint8_t *buf, size_t n);
+
+#if AX25_FIXED_PREFIX
+int32_t ax25_encode_fixed(uint8_t *out, size_t out_cap, const uint8_t *in, size_t inlen);
+#endif
+
 int32_t ax25_encode(uint8_t *out, const uint8_t *in, size_t inlen,ax25_frame_type_t type);
 
 
+size_t ax25_flag_scan(const uint8_t *in, size_t len, uint8_t prev);
+
+void ax25_deframer_init(ax25_deframer_t *d, uint8_t *out, size_t out_cap);
+
+size_t ax25_deframer_push(ax25_deframer_t *d, const uint8_t *in, size_t len);
+
+void ax25_rx_init(ax25_rx_ctx_t *ctx, ax25_rx_frame_cb_t on_frame, void *user);
+
+void ax25_rx_reset(ax25_rx_ctx_t *ctx);
+
+void ax25_rx_set_line_coding(ax25_rx_ctx_t *ctx, uint8_t line);
+
+void ax25_rx_set_recovery(ax25_rx_ctx_t *ctx, const ax25_recover_cfg_t *cfg);
+
+void ax25_rx_push(ax25_rx_ctx_t *ctx, const uint8_t *in, size_t len);
+
+size_t ax25_decode_batch(ax25_frame_desc_t *descs, size_t max_descs, uint8_t *arena, size_t arena_cap, const uint8_t *in, size_t len);
+
 uint32_t ax25_recv(uint8_t *out, const uint8_t *in, size_t len);
 
 ax25_decode_status_t ax25_decode (uint8_t *out, size_t *out_len, const uint8_t *ax25_frame,size_t len);
 
+ax25_decode_status_t ax25_digipeat(uint8_t *frame, size_t len, const uint8_t *call, uint8_t ssid);
+
+int ax25_fcs_recover(uint8_t *frame, size_t len, const uint8_t *conf, const ax25_recover_cfg_t *cfg);
+
+ax25_decode_status_t ax25_decode_soft(uint8_t *out, size_t *out_len, const int8_t *soft, size_t len, const ax25_recover_cfg_t *cfg);
+
 
 
 #endif /* AX25_H */
\ No newline at end of file
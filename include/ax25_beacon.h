@@ -0,0 +1,45 @@
+#ifndef AX25_BEACON_H /* AX25_BEACON_H */
+#define AX25_BEACON_H
+
+#include "ax25.h"
+
+/* Info bytes between two stuffer checkpoints */
+#ifndef AX25_BEACON_CP_STEP
+#define AX25_BEACON_CP_STEP 8
+#endif
+
+/**
+ * Stuffer state before an info byte, enough to resume stuffing from there
+ */
+typedef struct
+{
+  uint16_t out_idx;     //!< whole bytes written
+  uint8_t acc;          //!< bits not yet written, LSB is the latest
+  uint8_t acc_bits;
+  uint8_t cont_1;       //!< run of 1's
+  uint8_t nrzi_level;   //!< line coder state
+  uint32_t lfsr;
+} ax25_beacon_cp_t;
+
+/**
+ * Beacon template: a UI frame sent again and again with the same layout.
+ * Only the bytes that changed since the last frame are hashed, and the
+ * bitstream is stuffed again from the checkpoint before the first changed
+ * byte only.
+ */
+typedef struct
+{
+  ax25_enc_ctx_t ctx;
+  uint8_t info[AX25_MAX_FRAME_LEN];       //!< info field of the last frame
+  size_t len;                             //!< length of info, fixed
+  uint16_t fcs;                           //!< FCS register after info
+  ax25_beacon_cp_t cp[AX25_MAX_FRAME_LEN / AX25_BEACON_CP_STEP + 1];  //!< stuffer state every AX25_BEACON_CP_STEP info bytes
+  uint8_t bits[AX25_MAX_ENCODED_LEN];     //!< the encoded frame
+  size_t bits_len;                        //!< bytes of bits
+} ax25_beacon_template_t;
+
+int32_t ax25_beacon_init(ax25_beacon_template_t *b, const ax25_enc_ctx_t *ctx, const uint8_t *info, size_t len);
+
+int32_t ax25_beacon_update(ax25_beacon_template_t *b, const uint8_t *info);
+
+#endif /* AX25_BEACON_H */
@@ -0,0 +1,135 @@
+#ifndef AX25_CONN_H /* AX25_CONN_H */
+#define AX25_CONN_H
+
+#include "ax25.h"
+
+/*
+ * Frames kept for retransmission, the largest window usable. A power of
+ * two up to 128, so that N(S) modulo it never maps two outstanding frames
+ * to one slot. The default also caps modulo 128 links at a window of 8:
+ * raise it to 128 for the full SABME window, at the cost of one encoded
+ * frame of RAM per slot.
+ */
+#ifndef AX25_CONN_MAX_WINDOW
+#define AX25_CONN_MAX_WINDOW 8
+#endif
+
+#if AX25_CONN_MAX_WINDOW & (AX25_CONN_MAX_WINDOW - 1) || AX25_CONN_MAX_WINDOW > 128
+#error "AX25_CONN_MAX_WINDOW must be a power of two up to 128"
+#endif
+
+typedef enum
+{
+  AX25_CONN_DISCONNECTED, AX25_CONN_CONNECTING, AX25_CONN_CONNECTED, AX25_CONN_DISCONNECTING
+} ax25_conn_state_t;
+
+/**
+ * Connected mode settings. Times are in ms.
+ */
+typedef struct
+{
+  uint8_t mod128;       //!< modulo 128 sequence numbers (SABME), else modulo 8
+  uint8_t window;       //!< I frames outstanding, up to 7 (127 with mod128) and AX25_CONN_MAX_WINDOW
+  uint8_t n2;           //!< retries before the link is given up
+  uint32_t t1_init;     //!< retransmission timeout until the RTT is measured
+  uint32_t t1_min;      //!< bounds of the retransmission timeout
+  uint32_t t1_max;
+  uint32_t t2;          //!< delay before acknowledging I frames, 0 for at once
+} ax25_conn_cfg_t;
+
+/**
+ * Called with every frame the link sends, encoded and bit stuffed
+ * @param user the opaque pointer given to ax25_conn_init()
+ * @param bits the bitstream, MS bit first. Valid only during the call
+ * @param len length of bits
+ */
+typedef void (*ax25_conn_send_cb_t)(void *user, const uint8_t *bits, size_t len);
+
+/**
+ * Called with the info field of every I frame received in sequence
+ * @param user the opaque pointer given to ax25_conn_init()
+ * @param info the info field. Valid only during the call
+ * @param len length of info
+ */
+typedef void (*ax25_conn_recv_cb_t)(void *user, const uint8_t *info, size_t len);
+
+/**
+ * Called when the link is reset or released with I frames accepted by
+ * ax25_conn_send() still unacknowledged. They are dropped; queue them
+ * again once the link is back up.
+ * @param user the opaque pointer given to ax25_conn_init()
+ * @param dropped the number of frames dropped, the oldest ones not delivered
+ */
+typedef void (*ax25_conn_reset_cb_t)(void *user, size_t dropped);
+
+/**
+ * An I frame waiting for its acknowledgement, kept stuffed so it can be
+ * sent again without being rebuilt. It is line coded each time it is sent.
+ */
+typedef struct
+{
+  uint8_t bits[AX25_MAX_ENCODED_LEN];   //!< the encoded frame, stuffed, not line coded
+  uint16_t len;                         //!< bytes of bits
+  uint8_t nr;                           //!< N(R) carried by bits
+  uint32_t sent;                        //!< time of the first transmission
+  uint8_t retx;                         //!< retransmitted, so unfit for RTT measurement (Karn)
+} ax25_conn_slot_t;
+
+/**
+ * Connected mode link: sliding window of I frames acknowledged by RR, RNR,
+ * REJ and SREJ, with a retransmission timeout following the measured RTT.
+ * The caller feeds received frames and the time, the link never blocks.
+ */
+typedef struct
+{
+  ax25_conn_cfg_t cfg;
+  ax25_enc_ctx_t cmd;                   //!< address field of our commands
+  ax25_enc_ctx_t rsp;                   //!< address field of our responses
+  ax25_line_coder_t coder;              //!< line coding of every frame sent, runs on across frames
+  uint8_t peer_addr[AX25_MIN_ADDR_LEN]; //!< address field of the peer's frames, C bits cleared
+  ax25_conn_state_t state;
+  uint8_t modulus;
+  uint8_t vs;           //!< V(S), next sequence number to send
+  uint8_t va;           //!< V(A), oldest unacknowledged sequence number
+  uint8_t vr;           //!< V(R), next sequence number expected
+  uint8_t peer_busy;    //!< the peer sent RNR
+  uint8_t rej_sent;     //!< a REJ is outstanding
+  uint8_t ack_pending;  //!< I frames received but not acknowledged yet
+  uint8_t peer_up;      //!< an I or S frame came from the peer since link setup
+  uint8_t retries;
+  uint8_t t1_running;
+  uint8_t t2_running;
+  uint8_t rtt_valid;
+  uint32_t t1_expiry;
+  uint32_t t2_expiry;
+  uint32_t t1_start;    //!< when the U command being retried was first sent
+  uint32_t srtt;        //!< smoothed RTT
+  uint32_t rttvar;      //!< RTT variation
+  uint32_t t1;          //!< current retransmission timeout
+  ax25_conn_slot_t slots[AX25_CONN_MAX_WINDOW];  //!< retention pool, indexed by N(S)
+  uint8_t buf[AX25_MAX_ENCODED_LEN];    //!< S or U frame being sent
+  uint8_t tx[AX25_MAX_ENCODED_LEN];     //!< frame being sent, line coded
+  uint8_t frame[AX25_MAX_RAW_FRAME_LEN];  //!< I frame decoded back from its slot
+  ax25_conn_send_cb_t send;
+  ax25_conn_recv_cb_t recv;
+  ax25_conn_reset_cb_t on_reset;        //!< set after ax25_conn_init(), or NULL
+  void *user;
+} ax25_conn_t;
+
+int ax25_conn_init(ax25_conn_t *c, const ax25_conn_cfg_t *cfg, const uint8_t *local, uint8_t local_ssid, const uint8_t *remote, uint8_t remote_ssid, ax25_conn_send_cb_t send, ax25_conn_recv_cb_t recv, void *user);
+
+void ax25_conn_set_line_coding(ax25_conn_t *c, uint8_t line);
+
+void ax25_conn_connect(ax25_conn_t *c, uint32_t now);
+
+void ax25_conn_disconnect(ax25_conn_t *c, uint32_t now);
+
+size_t ax25_conn_window_free(const ax25_conn_t *c);
+
+int ax25_conn_send(ax25_conn_t *c, const uint8_t *data, size_t len, uint32_t now);
+
+void ax25_conn_input(ax25_conn_t *c, const uint8_t *frame, size_t len, uint32_t now);
+
+void ax25_conn_tick(ax25_conn_t *c, uint32_t now);
+
+#endif /* AX25_CONN_H */
@@ -0,0 +1,53 @@
+#ifndef AX25_FILTER_H /* AX25_FILTER_H */
+#define AX25_FILTER_H
+
+#include "ax25_ring.h"
+
+/* Rules of a filter table */
+#ifndef AX25_FILTER_MAX_RULES
+#define AX25_FILTER_MAX_RULES 8
+#endif
+
+/* Wildcard SSID, frame type or PID of a rule */
+#define AX25_FILTER_ANY 0xFF
+
+/**
+ * A filter rule, compared with the start of the frame in the layout of
+ * ax25_create_addr_field()
+ */
+typedef struct
+{
+  uint8_t addr[AX25_MIN_ADDR_LEN];  //!< destination and source addresses
+  uint8_t mask[AX25_MIN_ADDR_LEN];  //!< bits of addr that must match
+  uint8_t type;                     //!< ax25_frame_type_t, or AX25_FILTER_ANY
+  uint8_t pid;                      //!< PID of I and UI frames, or AX25_FILTER_ANY
+  ax25_ring_t *ring;                //!< receives the matching frames, NULL to drop them
+  uint32_t frames;                  //!< frames with a good FCS routed to ring
+} ax25_filter_rule_t;
+
+/**
+ * Receiver routing frames by their header. The deframer hands over the
+ * first AX25_DF_HDR_LEN bytes of each frame; the first matching rule
+ * decides where the rest is destuffed, straight into a free slot of its
+ * ring. Frames matching no rule are skipped up to the next flag without
+ * being stored or hashed. Frames relayed by digipeaters are matched on
+ * their addresses only.
+ */
+typedef struct
+{
+  ax25_deframer_t deframer;
+  ax25_filter_rule_t rules[AX25_FILTER_MAX_RULES];
+  size_t nrules;
+  ax25_filter_rule_t *match;                //!< rule of the frame being received
+  uint8_t scratch[AX25_MAX_RAW_FRAME_LEN];  //!< holds each frame until it is routed
+  uint32_t rejected;                        //!< frames skipped by the table
+  uint32_t dropped;                         //!< frames lost to a full ring
+} ax25_rx_filter_t;
+
+void ax25_rx_filter_init(ax25_rx_filter_t *rx);
+
+int ax25_rx_filter_add(ax25_rx_filter_t *rx, const uint8_t *dest, uint8_t dest_ssid, const uint8_t *src, uint8_t src_ssid, uint8_t type, uint8_t pid, ax25_ring_t *ring);
+
+void ax25_rx_filter_push(ax25_rx_filter_t *rx, const uint8_t *in, size_t len);
+
+#endif /* AX25_FILTER_H */
@@ -0,0 +1,34 @@
+/* Generated by tools/ax25_gen_fixed.c from include/config.h, do not edit */
+#ifndef AX25_FIXED_H /* AX25_FIXED_H */
+#define AX25_FIXED_H
+
+#include <stdint.h>
+
+/* UI frames from PARSAT-0 to ABCD-0 */
+#define AX25_FIXED_SAT_CALL_PARSAT 1
+#define AX25_FIXED_SAT_SSID 0
+#define AX25_FIXED_GRD_CALL_ABCD 1
+#define AX25_FIXED_GRD_SSID 0
+
+#define AX25_FIXED_HDR_LEN 16
+static const uint8_t ax25_fixed_hdr[16] =
+  { 0x82, 0x84, 0x86, 0x88, 0x40, 0x40, 0x60, 0xA0,
+    0x82, 0xA4, 0xA6, 0x82, 0xA8, 0x61, 0x03, 0xF0 };
+
+/* FCS register after the header */
+#define AX25_FIXED_HDR_FCS 0xCB91
+
+/*
+ * Opening flag and stuffed header: whole bytes, then the bits left in
+ * the stuffer accumulator and the run of 1's they end with
+ */
+#define AX25_FIXED_PREFIX_LEN 17
+static const uint8_t ax25_fixed_prefix[17] =
+  { 0x7E, 0x41, 0x21, 0x61, 0x11, 0x02, 0x02, 0x06,
+    0x05, 0x41, 0x25, 0x65, 0x41, 0x15, 0x86, 0xC0,
+    0x0F };
+#define AX25_FIXED_PREFIX_ACC 0x00
+#define AX25_FIXED_PREFIX_ACC_BITS 0
+#define AX25_FIXED_PREFIX_CONT_1 4
+
+#endif /* AX25_FIXED_H */
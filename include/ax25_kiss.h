@@ -0,0 +1,115 @@
+#ifndef AX25_KISS_H /* AX25_KISS_H */
+#define AX25_KISS_H
+
+#include <sys/uio.h>
+
+#include "ax25.h"
+
+/* Radio ports of a TNC, the KISS port nibble allows up to 16 */
+#ifndef AX25_KISS_MAX_PORTS
+#define AX25_KISS_MAX_PORTS 4
+#endif
+
+/* Bytes asked from the host at each read() */
+#ifndef AX25_KISS_READ_LEN
+#define AX25_KISS_READ_LEN 4096
+#endif
+
+/* Decoded frames a port holds for the host before a flush */
+#ifndef AX25_KISS_ARENA_LEN
+#define AX25_KISS_ARENA_LEN (16 * AX25_MAX_RAW_FRAME_LEN)
+#endif
+
+/* Most flags sent for TXDELAY, and for TXTAIL */
+#ifndef AX25_KISS_MAX_FLAGS
+#define AX25_KISS_MAX_FLAGS 1024
+#endif
+
+/* Segments gathered by a single writev() */
+#ifndef AX25_KISS_MAX_IOV
+#define AX25_KISS_MAX_IOV 64
+#endif
+
+#define AX25_KISS_FEND  0xC0
+#define AX25_KISS_FESC  0xDB
+#define AX25_KISS_TFEND 0xDC
+#define AX25_KISS_TFESC 0xDD
+
+/* Command nibble of the KISS type byte, the port is in the high nibble */
+#define AX25_KISS_CMD_DATA       0x0
+#define AX25_KISS_CMD_TXDELAY    0x1
+#define AX25_KISS_CMD_PERSIST    0x2
+#define AX25_KISS_CMD_SLOTTIME   0x3
+#define AX25_KISS_CMD_TXTAIL     0x4
+#define AX25_KISS_CMD_FULLDUPLEX 0x5
+#define AX25_KISS_CMD_SETHW      0x6
+#define AX25_KISS_RETURN         0xFF
+
+/**
+ * Called with every data frame the host sends, encoded, bit stuffed and
+ * line coded, between its TXDELAY and TXTAIL flags
+ * @param user the opaque pointer given to ax25_kiss_init()
+ * @param port the radio port the frame is for
+ * @param bits the bitstream, MS bit first. Valid only during the call
+ * @param len length of bits
+ */
+typedef void (*ax25_kiss_tx_cb_t)(void *user, uint8_t port, const uint8_t *bits, size_t len);
+
+/**
+ * A radio port. Received frames are destuffed straight into the arena,
+ * behind their KISS header, and handed to writev() from there.
+ */
+typedef struct
+{
+  ax25_deframer_t deframer;           //!< set its line coding directly
+  ax25_line_coder_t coder;            //!< line coding of the frames sent, runs on across frames
+  uint32_t bitrate;                   //!< line rate in bit/s, turns txdelay and txtail into flags
+  uint8_t arena[AX25_KISS_ARENA_LEN]; //!< frames waiting for the host, KISS framed
+  size_t tail;                        //!< start of the frame being received
+  uint8_t txdelay;                    //!< flags before each frame, in 10 ms
+  uint8_t persist;                    //!< channel access settings from the host
+  uint8_t slottime;
+  uint8_t txtail;                     //!< flags after each frame, in 10 ms
+  uint8_t full_duplex;
+} ax25_kiss_port_t;
+
+/**
+ * KISS TNC front-end. Bitstreams from the radios are deframed and the good
+ * frames are queued for the host, then written with one writev() by
+ * ax25_kiss_flush(). The host side, a serial port or a socket, is read in
+ * AX25_KISS_READ_LEN blocks; its data frames are encoded for the radios.
+ */
+typedef struct
+{
+  int fd;                                 //!< host side, blocking for writes
+  ax25_kiss_port_t ports[AX25_KISS_MAX_PORTS];
+  size_t nports;
+  struct iovec iov[AX25_KISS_MAX_IOV];    //!< frames queued for the host
+  size_t niov;
+  uint8_t esc[AX25_KISS_ARENA_LEN];       //!< queued frames that needed escaping
+  size_t esc_len;
+  uint8_t in[AX25_KISS_READ_LEN];         //!< last block read from the host
+  uint8_t rx[1 + AX25_MAX_RAW_FRAME_LEN]; //!< type byte and frame being received from the host
+  size_t rx_len;
+  uint8_t rx_esc;                         //!< the last byte from the host was FESC
+  uint8_t rx_drop;                        //!< the frame from the host is too long
+  uint8_t bits[AX25_MAX_ENCODED_LEN + 2 * AX25_KISS_MAX_FLAGS];  //!< frame being sent to a radio, with its flags
+  ax25_kiss_tx_cb_t tx;
+  void *user;
+} ax25_kiss_t;
+
+int ax25_kiss_init(ax25_kiss_t *k, int fd, size_t nports, ax25_kiss_tx_cb_t tx, void *user);
+
+void ax25_kiss_set_line_coding(ax25_kiss_t *k, uint8_t port, uint8_t line);
+
+void ax25_kiss_set_bitrate(ax25_kiss_t *k, uint8_t port, uint32_t bitrate);
+
+int ax25_kiss_radio_push(ax25_kiss_t *k, uint8_t port, const uint8_t *in, size_t len);
+
+int ax25_kiss_flush(ax25_kiss_t *k);
+
+void ax25_kiss_host_push(ax25_kiss_t *k, const uint8_t *in, size_t len);
+
+ssize_t ax25_kiss_host_read(ax25_kiss_t *k);
+
+#endif /* AX25_KISS_H */
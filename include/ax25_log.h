@@ -0,0 +1,123 @@
+#ifndef AX25_LOG_H /* AX25_LOG_H */
+#define AX25_LOG_H
+
+#include <stdio.h>
+
+#include "ax25.h"
+
+/**
+ * Log levels. AX25_LOG_LEVEL is the highest level compiled in; the calls
+ * above it, and all of them with AX25_LOG_NONE, compile to nothing and
+ * src/ax25_log.c need not be linked.
+ */
+#define AX25_LOG_NONE  0
+#define AX25_LOG_ERROR 1
+#define AX25_LOG_WARN  2
+#define AX25_LOG_INFO  3
+#define AX25_LOG_DEBUG 4
+
+#ifndef AX25_LOG_LEVEL
+#define AX25_LOG_LEVEL AX25_LOG_NONE
+#endif
+
+/* Records held by the deferred log, a power of two */
+#ifndef AX25_LOG_RING_LEN
+#define AX25_LOG_RING_LEN 64
+#endif
+
+#if AX25_LOG_RING_LEN & (AX25_LOG_RING_LEN - 1)
+#error "AX25_LOG_RING_LEN must be a power of two"
+#endif
+
+#define AX25_LOG_MAX_ARGS 3
+
+/**
+ * Events logged by the library. The arguments of each are listed.
+ */
+typedef enum
+{
+  AX25_LOG_EV_ENCODED,    //!< frame encoded by ax25_encode(): length, frame type
+  AX25_LOG_EV_FCS_ERROR,  //!< frame with a bad FCS: length, FCS computed, FCS received
+  AX25_LOG_EV_ABORT,      //!< frame cut by an abort: bytes received
+  AX25_LOG_EV_OVERSIZE,   //!< frame longer than the deframer buffer: buffer size
+  AX25_LOG_EV_NO_FLAG,    //!< one-shot decode without any flag
+  AX25_LOG_EV_TRUNCATED,  //!< one-shot decode without a complete frame: bytes of the unfinished frame
+  AX25_LOG_NEVENTS
+} ax25_log_event_t;
+
+/**
+ * A logged event, formatted later by ax25_log_format()
+ */
+typedef struct
+{
+  uint32_t seq;                       //!< events logged before this one, gaps are drops
+  uint8_t event;                      //!< ax25_log_event_t
+  uint8_t level;
+  uint32_t args[AX25_LOG_MAX_ARGS];
+} ax25_log_record_t;
+
+/**
+ * Receives log records
+ * @param user the opaque pointer given to ax25_log_set_sink()
+ * @param rec the record. Valid only during the call
+ */
+typedef void (*ax25_log_sink_t)(void *user, const ax25_log_record_t *rec);
+
+/**
+ * Logger. In deferred mode the hot path only stores records into a
+ * lock-free ring with many producers, any thread or interrupt handler
+ * logging an event, and a single consumer, ax25_log_drain(), which hands
+ * them to the sink later, e.g. from a low priority task. Without it the
+ * sink is called from every producer and must be reentrant.
+ */
+typedef struct
+{
+  ax25_log_sink_t sink;
+  void *user;
+  uint8_t level;        //!< records above this level are discarded
+  uint8_t deferred;     //!< records go through ring
+  uint32_t seq;         //!< events logged
+  uint32_t head;        //!< ring entries reserved by the producers, free running
+  uint32_t tail;        //!< records drained, free running, written by the consumer
+  uint32_t dropped;     //!< records lost to a full ring
+  uint32_t ready[AX25_LOG_RING_LEN];  //!< 1 + the head value of the record last published in each entry
+  ax25_log_record_t ring[AX25_LOG_RING_LEN];
+} ax25_log_t;
+
+extern ax25_log_t ax25_log;
+
+#if AX25_LOG_LEVEL >= AX25_LOG_ERROR
+#define AX25_LOG_ERR(ev, a0, a1, a2) ax25_log_write(AX25_LOG_ERROR, (ev), (a0), (a1), (a2))
+#else
+#define AX25_LOG_ERR(ev, a0, a1, a2) ((void)0)
+#endif
+
+#if AX25_LOG_LEVEL >= AX25_LOG_WARN
+#define AX25_LOG_WRN(ev, a0, a1, a2) ax25_log_write(AX25_LOG_WARN, (ev), (a0), (a1), (a2))
+#else
+#define AX25_LOG_WRN(ev, a0, a1, a2) ((void)0)
+#endif
+
+#if AX25_LOG_LEVEL >= AX25_LOG_INFO
+#define AX25_LOG_INF(ev, a0, a1, a2) ax25_log_write(AX25_LOG_INFO, (ev), (a0), (a1), (a2))
+#else
+#define AX25_LOG_INF(ev, a0, a1, a2) ((void)0)
+#endif
+
+#if AX25_LOG_LEVEL >= AX25_LOG_DEBUG
+#define AX25_LOG_DBG(ev, a0, a1, a2) ax25_log_write(AX25_LOG_DEBUG, (ev), (a0), (a1), (a2))
+#else
+#define AX25_LOG_DBG(ev, a0, a1, a2) ((void)0)
+#endif
+
+void ax25_log_set_sink(ax25_log_sink_t sink, void *user, uint8_t level, uint8_t deferred);
+
+void ax25_log_write(uint8_t level, ax25_log_event_t event, uint32_t a0, uint32_t a1, uint32_t a2);
+
+size_t ax25_log_drain(size_t max);
+
+int ax25_log_format(char *buf, size_t cap, const ax25_log_record_t *rec);
+
+void ax25_log_stdio_sink(void *user, const ax25_log_record_t *rec);
+
+#endif /* AX25_LOG_H */
@@ -0,0 +1,126 @@
+#ifndef AX25_PROF_H /* AX25_PROF_H */
+#define AX25_PROF_H
+
+#include "ax25.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/* Most recent stage timings kept for the telemetry dump */
+#ifndef AX25_PROF_RING_LEN
+#define AX25_PROF_RING_LEN 32
+#endif
+
+/**
+ * Stages of the encode and decode paths that are timed
+ */
+typedef enum
+{
+  AX25_PROF_ADDR,       //!< address field build, ax25_enc_init_path()
+  AX25_PROF_FRAME,      //!< frame assembly, ax25_create_frame()
+  AX25_PROF_FCS,        //!< FCS of the frame being encoded
+  AX25_PROF_STUFF,      //!< bit stuffing of the frame being encoded
+  AX25_PROF_PACK,       //!< flush of the last bits, ax25_stuffer_finish()
+  AX25_PROF_FLAG_SCAN,  //!< ax25_flag_scan() calls of the deframer
+  AX25_PROF_DESTUFF,    //!< ax25_deframer_push() calls, flag scans included
+  AX25_PROF_NSTAGES
+} ax25_prof_stage_t;
+
+/**
+ * A timed run of a stage
+ */
+typedef struct
+{
+  uint8_t stage;        //!< ax25_prof_stage_t
+  uint32_t cycles;
+} ax25_prof_sample_t;
+
+/**
+ * Totals of a stage since the last reset
+ */
+typedef struct
+{
+  uint32_t count;
+  uint32_t max;         //!< longest run, cycles
+  uint64_t total;       //!< cycles
+} ax25_prof_stage_stats_t;
+
+/**
+ * Receive diagnostics and stage timings. The counters are kept with
+ * AX25_STATS, the timings with AX25_PROF. Receivers on other threads and
+ * in interrupt handlers share them: every field is updated and read with
+ * relaxed atomics, so totals are exact but a dump taken while frames are
+ * received is not a single snapshot.
+ */
+typedef struct
+{
+  uint32_t frames;      //!< frames received with a good FCS
+  uint32_t fcs_errors;  //!< frames received with a bad FCS
+  uint32_t aborts;      //!< frames cut by an abort sequence
+  uint32_t oversize;    //!< frames longer than the deframer buffer
+  uint32_t no_flag;     //!< one-shot decodes without any flag in the input
+  uint32_t truncated;   //!< one-shot decodes without a complete frame
+#if AX25_PROF
+  ax25_prof_stage_stats_t stages[AX25_PROF_NSTAGES];
+  ax25_prof_sample_t ring[AX25_PROF_RING_LEN];
+  uint32_t ring_next;   //!< samples recorded, the next entry of ring is ring_next % AX25_PROF_RING_LEN
+#endif
+} ax25_prof_t;
+
+/* Bytes written by ax25_prof_dump() */
+#if AX25_PROF
+#define AX25_PROF_DUMP_LEN (6 * 4 + AX25_PROF_NSTAGES * 16 + 4 + AX25_PROF_RING_LEN * 5)
+#else
+#define AX25_PROF_DUMP_LEN (6 * 4)
+#endif
+
+extern ax25_prof_t ax25_prof;
+
+/**
+ * Reads the free running cycle counter: DWT CYCCNT on Cortex-M3/M4/M7/M33,
+ * TSC on x86, the generic timer on AArch64, else 0
+ */
+static inline uint32_t ax25_prof_cycles(void)
+{
+#if defined(__ARM_ARCH_7M__) || defined(__ARM_ARCH_7EM__) || defined(__ARM_ARCH_8M_MAIN__)
+    return *(volatile uint32_t *)0xE0001004;
+#elif defined(__x86_64__) || defined(__i386__)
+    return (uint32_t)__rdtsc();
+#elif defined(__aarch64__)
+    uint64_t v;
+
+    __asm__ volatile("mrs %0, cntvct_el0" : "=r"(v));
+    return (uint32_t)v;
+#else
+    return 0;
+#endif
+}
+
+#if AX25_PROF
+#define AX25_PROF_START(t) uint32_t t = ax25_prof_cycles()
+#define AX25_PROF_END(stage, t) ax25_prof_record(stage, ax25_prof_cycles() - (t))
+#else
+#define AX25_PROF_START(t) ((void)0)
+#define AX25_PROF_END(stage, t) ((void)0)
+#endif
+
+/* Relaxed atomic update and read of a field of ax25_prof */
+#define AX25_PROF_ADD(field, n) ((void)__atomic_fetch_add(&ax25_prof.field, (n), __ATOMIC_RELAXED))
+#define AX25_PROF_LOAD(field) __atomic_load_n(&ax25_prof.field, __ATOMIC_RELAXED)
+
+#if AX25_STATS
+#define AX25_STATS_INC(counter) AX25_PROF_ADD(counter, 1)
+#else
+#define AX25_STATS_INC(counter) ((void)0)
+#endif
+
+void ax25_prof_init(void);
+
+void ax25_prof_reset(void);
+
+void ax25_prof_record(ax25_prof_stage_t stage, uint32_t cycles);
+
+size_t ax25_prof_dump(uint8_t *out, size_t out_cap);
+
+#endif /* AX25_PROF_H */
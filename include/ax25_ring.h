@@ -0,0 +1,62 @@
+#ifndef AX25_RING_H /* AX25_RING_H */
+#define AX25_RING_H
+
+#include "ax25.h"
+
+/* Slots of a ring, a power of two */
+#ifndef AX25_RING_SLOTS
+#define AX25_RING_SLOTS 8
+#endif
+
+#if AX25_RING_SLOTS & (AX25_RING_SLOTS - 1)
+#error "AX25_RING_SLOTS must be a power of two"
+#endif
+
+/* Slot sizes fitting any decoded frame, FCS included, and any encoded frame */
+#define AX25_RX_RING_SLOT_SIZE AX25_MAX_RAW_FRAME_LEN
+#define AX25_TX_RING_SLOT_SIZE AX25_MAX_ENCODED_LEN
+
+/**
+ * Lock-free single producer, single consumer ring of frames. The slots are
+ * preallocated by the caller and filled and read in place. head is only
+ * written by the producer and tail by the consumer, so either side may run
+ * in interrupt context.
+ */
+typedef struct
+{
+  uint32_t head;                    //!< slots committed by the producer, free running
+  uint32_t tail;                    //!< slots released by the consumer, free running
+  uint16_t len[AX25_RING_SLOTS];    //!< bytes used in each slot
+  uint8_t *slots;                   //!< AX25_RING_SLOTS * slot_size bytes
+  size_t slot_size;
+} ax25_ring_t;
+
+/**
+ * Receiver destuffing straight into the free slots of a ring. Frames
+ * received while the ring is full are counted and dropped.
+ */
+typedef struct
+{
+  ax25_deframer_t deframer;
+  ax25_ring_t *ring;
+  uint8_t scratch[AX25_MAX_RAW_FRAME_LEN];  //!< target of the deframer while the ring is full
+  uint32_t dropped;                         //!< good frames lost to a full ring
+} ax25_rx_ring_t;
+
+void ax25_ring_init(ax25_ring_t *r, uint8_t *slots, size_t slot_size);
+
+uint8_t *ax25_ring_acquire(ax25_ring_t *r);
+
+void ax25_ring_commit(ax25_ring_t *r, size_t len);
+
+const uint8_t *ax25_ring_peek(ax25_ring_t *r, size_t *len);
+
+void ax25_ring_release(ax25_ring_t *r);
+
+int ax25_rx_ring_init(ax25_rx_ring_t *rx, ax25_ring_t *ring);
+
+void ax25_rx_ring_push(ax25_rx_ring_t *rx, const uint8_t *in, size_t len);
+
+int32_t ax25_tx_ring_encode(ax25_ring_t *r, const ax25_enc_ctx_t *ctx, const uint8_t *in, size_t inlen, ax25_frame_type_t type);
+
+#endif /* AX25_RING_H */
@@ -0,0 +1,97 @@
+#ifndef AX25_RX_GROUP_H /* AX25_RX_GROUP_H */
+#define AX25_RX_GROUP_H
+
+#include <pthread.h>
+
+#include "ax25.h"
+
+/* Bitstreams a group can decode, at most the 16 bits of ax25_rx_group_seen_t.streams */
+#define AX25_RX_GROUP_MAX_STREAMS 16
+
+/* Recently reported frames remembered for deduplication */
+#define AX25_RX_GROUP_RECENT 64
+
+/**
+ * Called once for every distinct frame decoded by a group
+ * @param user the opaque pointer given to ax25_rx_group_init()
+ * @param stream index of the stream that received the frame first
+ * @param frame the frame without the FCS. Valid only during the call
+ * @param len length of frame
+ */
+typedef void (*ax25_rx_group_cb_t)(void *user, size_t stream, const uint8_t *frame, size_t len);
+
+/**
+ * A frame found by a stream, kept until the streams are merged
+ */
+typedef struct
+{
+  uint64_t pos;                           //!< stream byte holding the end of the frame
+  uint32_t hash;                          //!< hash of the frame contents
+  uint16_t fcs;                           //!< FCS received with the frame
+  uint16_t len;                           //!< length of the frame without the FCS
+  uint8_t data[AX25_MAX_RAW_FRAME_LEN];
+} ax25_rx_group_frame_t;
+
+/**
+ * One bitstream of a group, e.g. a demodulator hypothesis
+ */
+typedef struct
+{
+  ax25_rx_ctx_t rx;                 //!< receiver, set its line coding and recovery directly
+  const uint8_t *in;                //!< chunk being decoded
+  size_t in_len;                    //!< length of in
+  uint64_t pos;                     //!< bytes decoded before in
+  ax25_rx_group_frame_t *frames;    //!< frames found in the chunk
+  size_t nframes;                   //!< entries used in frames
+  size_t frames_cap;                //!< entries allocated in frames
+  int failed;                       //!< frames were dropped for lack of memory
+} ax25_rx_group_stream_t;
+
+/**
+ * Recently reported frame
+ */
+typedef struct
+{
+  uint64_t pos;
+  uint32_t hash;
+  uint16_t fcs;
+  uint16_t len;
+  uint16_t streams;   //!< bit i set once stream i decoded the frame
+} ax25_rx_group_seen_t;
+
+/**
+ * Decodes several time aligned bitstreams carrying the same traffic, such
+ * as the hypotheses of a demodulator, on a pool of worker threads. A frame
+ * decoded by more than one stream is reported once, for the stream that
+ * completed it at the earliest byte. Only copies from different streams
+ * are merged: a frame decoded again by the same stream, e.g. a repeated
+ * beacon, is a new transmission and is reported again.
+ */
+typedef struct
+{
+  ax25_rx_group_stream_t streams[AX25_RX_GROUP_MAX_STREAMS];
+  size_t nstreams;
+  ax25_rx_group_seen_t recent[AX25_RX_GROUP_RECENT];  //!< ring of reported frames
+  size_t recent_next;                                 //!< next entry of recent to replace
+  uint64_t dedup_window;  //!< bytes within which copies of a frame are duplicates
+  ax25_rx_group_cb_t on_frame;
+  void *user;
+
+  pthread_t workers[AX25_RX_GROUP_MAX_STREAMS];
+  size_t nworkers;
+  pthread_mutex_t lock;
+  pthread_cond_t work_cv;   //!< signalled when a chunk is ready
+  pthread_cond_t done_cv;   //!< signalled when the last stream is done
+  uint32_t gen;             //!< incremented for every chunk
+  size_t next_stream;       //!< next stream to hand to a worker
+  size_t pending;           //!< streams not done yet
+  int stop;
+} ax25_rx_group_t;
+
+int ax25_rx_group_init(ax25_rx_group_t *g, size_t nstreams, size_t nworkers, ax25_rx_group_cb_t on_frame, void *user);
+
+void ax25_rx_group_push(ax25_rx_group_t *g, const uint8_t *const *in, const size_t *len);
+
+void ax25_rx_group_destroy(ax25_rx_group_t *g);
+
+#endif /* AX25_RX_GROUP_H */
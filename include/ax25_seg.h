@@ -0,0 +1,108 @@
+#ifndef AX25_SEG_H /* AX25_SEG_H */
+#define AX25_SEG_H
+
+#include "ax25.h"
+
+/**
+ * Segment header, at the start of the info field of every UI frame of a
+ * transfer. All fields are big endian.
+ *   0-1  transfer ID
+ *   2-3  index of the segment
+ *   4-5  number of segments of the transfer
+ */
+#define AX25_SEG_HDR_LEN 6
+
+/* Largest payload slice a segment can carry */
+#define AX25_SEG_MAX_DATA (AX25_MAX_FRAME_LEN - AX25_SEG_HDR_LEN)
+
+/* Largest payload that can be sent as one transfer */
+#define AX25_SEG_MAX_PAYLOAD ((size_t)UINT16_MAX * AX25_SEG_MAX_DATA)
+
+/**
+ * Segmenting transmitter. Cuts a payload into UI frames and streams them
+ * back to back, each frame opened by the closing flag of the previous one.
+ * Frames are built as the bitstream is pulled, so the radio can start on
+ * the first one right away.
+ */
+typedef struct
+{
+  ax25_tx_t tx;
+  const ax25_enc_ctx_t *ctx;
+  const uint8_t *data;        //!< the payload, referenced
+  size_t len;                 //!< length of data
+  size_t seg_len;             //!< payload bytes per segment
+  uint16_t xfer_id;
+  uint16_t seg_count;         //!< segments of the transfer
+  uint16_t seg_next;          //!< next segment to load
+  uint8_t hdr[AX25_SEG_HDR_LEN];
+} ax25_seg_tx_t;
+
+/* Transfers a reassembler can hold at the same time */
+#ifndef AX25_SEG_RX_XFERS
+#define AX25_SEG_RX_XFERS 4
+#endif
+
+/**
+ * Called when every segment of a transfer is in
+ * @param user the opaque pointer given to ax25_seg_rx_init()
+ * @param xfer_id the transfer
+ * @param data the payload, in the slab until ax25_seg_rx_release()
+ * @param len length of data
+ */
+typedef void (*ax25_seg_rx_cb_t)(void *user, uint16_t xfer_id, const uint8_t *data, size_t len);
+
+/**
+ * A transfer being reassembled. Its region of the slab holds the bitmap of
+ * the received segments followed by the payload.
+ */
+typedef struct
+{
+  size_t off;           //!< start of the region in the slab
+  size_t size;          //!< bytes of the region
+  uint16_t xfer_id;
+  uint16_t seg_count;
+  uint16_t seg_len;     //!< payload bytes per segment, 0 until known
+  uint16_t last_len;    //!< payload bytes of the last segment
+  uint16_t received;    //!< segments received so far
+  uint8_t in_use;
+  uint8_t complete;     //!< handed over, waiting for ax25_seg_rx_release()
+  uint8_t last_parked;  //!< the last segment came first and is parked at the end
+} ax25_seg_xfer_t;
+
+/**
+ * Reassembler of segmented transfers. Segments are copied once, from the
+ * frame straight to their place in the object, in any order.
+ */
+typedef struct
+{
+  uint8_t *slab;        //!< storage of all the transfers
+  size_t slab_cap;
+  ax25_seg_xfer_t xfers[AX25_SEG_RX_XFERS];
+  ax25_seg_rx_cb_t on_complete;
+  void *user;
+  uint32_t dropped;     //!< segments refused: no room, or inconsistent
+} ax25_seg_rx_t;
+
+size_t ax25_seg_count(size_t len, size_t seg_len);
+
+size_t ax25_seg_encoded_size_max(size_t len, size_t seg_len);
+
+ax25_encode_status_t ax25_seg_tx_start(ax25_seg_tx_t *st, const ax25_enc_ctx_t *ctx, uint16_t xfer_id, const uint8_t *data, size_t len, size_t seg_len);
+
+size_t ax25_seg_tx_next_chunk(ax25_seg_tx_t *st, uint8_t *buf, size_t n);
+
+size_t ax25_seg_tx_sent(const ax25_seg_tx_t *st);
+
+int32_t ax25_seg_encode(const ax25_enc_ctx_t *ctx, uint8_t *out, size_t out_cap, uint16_t xfer_id, const uint8_t *data, size_t len, size_t seg_len);
+
+void ax25_seg_rx_init(ax25_seg_rx_t *r, uint8_t *slab, size_t slab_cap, ax25_seg_rx_cb_t on_complete, void *user);
+
+void ax25_seg_rx_frame(void *user, const uint8_t *frame, size_t len);
+
+void ax25_seg_rx_segment(ax25_seg_rx_t *r, const uint8_t *info, size_t len);
+
+size_t ax25_seg_rx_missing(const ax25_seg_rx_t *r, uint16_t xfer_id, uint8_t *out, size_t out_cap);
+
+void ax25_seg_rx_release(ax25_seg_rx_t *r, uint16_t xfer_id);
+
+#endif /* AX25_SEG_H */
@@ -0,0 +1,18 @@
+#ifndef AX25_VERIFY_H /* AX25_VERIFY_H */
+#define AX25_VERIFY_H
+
+#include <pthread.h>
+
+#include "ax25.h"
+
+/* Threads a verification can use */
+#define AX25_VERIFY_MAX_THREADS 16
+
+/* Smallest chunk worth a thread of its own */
+#define AX25_VERIFY_MIN_CHUNK (64 * 1024)
+
+uint16_t ax25_crc16_parallel(const uint8_t *buf, size_t len, size_t nthreads);
+
+ax25_decode_status_t ax25_verify_crc16(const uint8_t *buf, size_t len, uint16_t expected, size_t nthreads);
+
+#endif /* AX25_VERIFY_H */
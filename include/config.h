@@ -9,11 +9,18 @@
  *                         2. ssid is set to 0 need for change?
 */
 
-static const char SAT_CALLSIGN[] = "PARSAT";
-static const uint8_t SAT_SSID = 0;
+/* Callsigns are bare tokens, so the preprocessor can check ax25_fixed.h */
+#define SAT_CALL PARSAT
+#define SAT_SSID 0
 
-static const char GRD_CALLSIGN[] = "ABCD";
-static const uint8_t GRD_SSID = 0;
+#define GRD_CALL ABCD
+#define GRD_SSID 0
+
+#define CONFIG_STR_(x) #x
+#define CONFIG_STR(x) CONFIG_STR_(x)
+
+static const char SAT_CALLSIGN[] = CONFIG_STR(SAT_CALL);
+static const char GRD_CALLSIGN[] = CONFIG_STR(GRD_CALL);
 
 
 
@@ -111,6 +111,65 @@
       return update_crc16_ccitt_reversed(0xFFFF, data, len) ^ 0xFFFF;
     }
 
+    /**
+     * x^(8 * 2^k) modulo the CCITT polynomial, reflected. The powers repeat
+     * with a period of 15 in k.
+     */
+    static const uint16_t crc16_ccitt_reversed_x2n[15] =
+      { 0x0080, 0x8408, 0x0CEC, 0x861D, 0x3F75, 0x9471, 0x3FC8, 0x236C,
+	  0x0ABF, 0x7955, 0x3811, 0x1A22, 0x4000, 0x2000, 0x0800 };
+
+    /**
+     * Multiplies two polynomials modulo the CCITT polynomial, in the
+     * reflected order of crc16_ccitt_reversed(): bit 15 holds x^0
+     */
+    static inline uint16_t
+    crc16_ccitt_reversed_mulmod (uint16_t a, uint16_t b)
+    {
+      uint16_t m = 0x8000;
+      uint16_t p = 0;
+
+      while (a) {
+	if (a & m) {
+	  p ^= b;
+	  a ^= m;
+	}
+	m >>= 1;
+	b = (b & 0x1) ? (b >> 1) ^ crc16_ccitt_table_reverse[128] : b >> 1;
+      }
+      return p;
+    }
+
+    /**
+     * Advances a CRC register over len zero bytes in O(log len) steps, the
+     * same as update_crc16_ccitt_reversed() over a zero buffer
+     */
+    static inline uint16_t
+    crc16_ccitt_reversed_shift (uint16_t crc, size_t len)
+    {
+      size_t k;
+
+      for (k = 0; len; len >>= 1, k++) {
+	if (len & 0x1) {
+	  crc = crc16_ccitt_reversed_mulmod(crc16_ccitt_reversed_x2n[k % 15], crc);
+	}
+      }
+      return crc;
+    }
+
+    /**
+     * Combines the crc16_ccitt_reversed() of two consecutive buffers into
+     * that of their concatenation, without reading the data again
+     * @param crc_a CRC of the first buffer
+     * @param crc_b CRC of the second buffer
+     * @param len_b length of the second buffer
+     */
+    static inline uint16_t
+    crc16_combine (uint16_t crc_a, uint16_t crc_b, size_t len_b)
+    {
+      return crc16_ccitt_reversed_shift(crc_a, len_b) ^ crc_b;
+    }
+
     static uint16_t
     update_crc16_ccitt (uint16_t crc, const uint8_t *buf, size_t len)
     {
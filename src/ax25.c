@@ -1,49 +1,132 @@
 #include "ax25.h"
-#include <stdio.h>
-const uint8_t AX25_SYNC_FLAG_MAP_BIN[8] = {0, 1, 1, 1, 1, 1, 1, 0};
+#include "ax25_log.h"
+#include "ax25_prof.h"
+#if AX25_FIXED_PREFIX
+#include "ax25_fixed.h"
+
+/* The header is only valid for the stations of config.h */
+#define AX25_PASTE_(a, b) a##b
+#define AX25_PASTE(a, b) AX25_PASTE_(a, b)
+#if !AX25_PASTE(AX25_FIXED_SAT_CALL_, SAT_CALL) || !AX25_PASTE(AX25_FIXED_GRD_CALL_, GRD_CALL) \
+    || AX25_FIXED_SAT_SSID != SAT_SSID || AX25_FIXED_GRD_SSID != GRD_SSID
+#error "include/ax25_fixed.h does not match include/config.h, regenerate it with tools/ax25_gen_fixed.c"
+#endif
+#endif
 
 /**
- * Creates the address field of the AX.25 frame
- * @param out the output buffer with enough memory to hold the address field
- * @param dest_addr the destination callsign address
- * @param dest_ssid the destination SSID
- * @param src_addr the callsign of the source
- * @param src_ssid the source SSID
+ * Deframer transition table entry, indexed by (run of 1's, input byte).
+ * Input bits are processed MSB first up to, and including, the first flag
+ * or abort.
  */
-size_t ax25_create_addr_field(uint8_t *out, const uint8_t *dest_addr, uint8_t dest_ssid, const uint8_t *src_addr, uint8_t src_ssid)
+#define AX25_DF_DATA(e)   ((e) & 0xFF)          /* destuffed bits, LSB first */
+#define AX25_DF_NDATA(e)  (((e) >> 8) & 0xF)    /* number of destuffed bits */
+#define AX25_DF_CONT1(e)  (((e) >> 12) & 0x7)   /* run of 1's afterwards */
+#define AX25_DF_EVENT(e)  (((e) >> 16) & 0x3)   /* AX25_DF_EV_xxx */
+#define AX25_DF_USED(e)   (((e) >> 20) & 0xF)   /* input bits consumed */
+
+#define AX25_DF_EV_NONE  0
+#define AX25_DF_EV_FLAG  1
+#define AX25_DF_EV_ABORT 2
+
+/* Run of 1's states: 0-5 data, 6 flag pending, 7 abort */
+#define AX25_DF_STATES 8
+
+/*
+ * Received bytes are added to the FCS in blocks of this size while the
+ * frame is coming in, so only the last block is left at the closing flag
+ */
+#define AX25_DF_FCS_BLOCK 64
+
+/* Bytes fed to the tables after a flag candidate before scanning again */
+#define AX25_DF_SCAN_GAP 8
+
+static uint32_t ax25_deframer_table[AX25_DF_STATES][256];
+static uint8_t ax25_deframer_table_ready = 0;
+
+/*
+ * Writes one address: the callsign shifted left, padded with spaces, then
+ * the SSID byte
+ * @param bits the C/H bit and the extension bit of the SSID byte
+ */
+static uint8_t *ax25_put_addr(uint8_t *out, const uint8_t *call, uint8_t ssid, uint8_t bits)
 {
-    uint16_t i = 0;
+    size_t i;
 
-    for (i = 0; i < strnlen(dest_addr, AX25_MAX_ADDR_LEN); i++)
+    for (i = 0; i < AX25_CALLSIGN_MAX_LEN && call[i]; i++)
     {
-        *out++ = dest_addr[i] << 1;
+        *out++ = call[i] << 1;
     }
     /*
-     * Perhaps the destination callsign was smaller that the maximum allowed.
+     * Perhaps the callsign was smaller that the maximum allowed.
      * In this case the leftover bytes should be filled with space
      */
     for (; i < AX25_CALLSIGN_MAX_LEN; i++)
     {
         *out++ = ' ' << 1;
     }
-    /* Apply SSID, reserved and C bit */
-    /* FIXME: C bit is set to 0 implicitly */
-    *out++ = ((0x0F & dest_ssid) << 1) | 0x60;
-    
-    for (i = 0; i < strnlen(src_addr, AX25_MAX_ADDR_LEN); i++)
+    /* Apply SSID, reserved bits and the C/H and extension bits */
+    *out++ = ((0x0F & ssid) << 1) | 0x60 | bits;
+    return out;
+}
+
+/**
+ * Creates the address field of the AX.25 frame
+ * @param out the output buffer with enough memory to hold the address field
+ * @param dest_addr the destination callsign address
+ * @param dest_ssid the destination SSID
+ * @param src_addr the callsign of the source
+ * @param src_ssid the source SSID
+ */
+size_t ax25_create_addr_field(uint8_t *out, const uint8_t *dest_addr, uint8_t dest_ssid, const uint8_t *src_addr, uint8_t src_ssid)
+{
+    return ax25_create_addr_path(out, dest_addr, dest_ssid, src_addr, src_ssid, NULL, 0);
+}
+
+/**
+ * Creates the address field of a frame relayed by digipeaters. The C bits
+ * are left to 0 and the H bits are cleared.
+ * @param out the output buffer, AX25_MAX_ADDR_LEN bytes are always enough
+ * @param dest_addr the destination callsign address
+ * @param dest_ssid the destination SSID
+ * @param src_addr the callsign of the source
+ * @param src_ssid the source SSID
+ * @param digis the digipeaters, in the order the frame goes through them
+ * @param ndigis number of digipeaters, up to AX25_MAX_DIGIS
+ * @return the length of the address field, or 0 if there are too many
+ * digipeaters
+ */
+size_t ax25_create_addr_path(uint8_t *out, const uint8_t *dest_addr, uint8_t dest_ssid, const uint8_t *src_addr, uint8_t src_ssid, const ax25_digi_t *digis, size_t ndigis)
+{
+    size_t i;
+
+    if (ndigis > AX25_MAX_DIGIS)
     {
-        *out++ = src_addr[i] << 1;
+        return 0;
     }
-    for (; i < AX25_CALLSIGN_MAX_LEN; i++)
+    /* The last address of the field has the extension bit set */
+    out = ax25_put_addr(out, dest_addr, dest_ssid, 0);
+    out = ax25_put_addr(out, src_addr, src_ssid, ndigis ? 0 : 0x01);
+    for (i = 0; i < ndigis; i++)
     {
-        *out++ = ' ' << 1;
+        out = ax25_put_addr(out, digis[i].call, digis[i].ssid, i + 1 == ndigis ? 0x01 : 0);
     }
-    /* Apply SSID, reserved and C bit. As this is the last address field
-     * the trailing bit is set to 1. as last bit of address.
-     */
-    /* FIXME: C bit is set to 0 implicitly */
-    *out++ = ((0x0F & dest_ssid) << 1) | 0x61;
-    return (size_t)AX25_MIN_ADDR_LEN;
+    return AX25_MIN_ADDR_LEN + ndigis * AX25_ADDR_LEN;
+}
+
+/**
+ * Tells whether an address of a frame is a given station. The C/H and
+ * extension bits are ignored.
+ * @param addr the address, AX25_ADDR_LEN bytes
+ * @param call the callsign
+ * @param ssid the SSID
+ * @return 1 if they match, else 0
+ */
+int ax25_addr_match(const uint8_t *addr, const uint8_t *call, uint8_t ssid)
+{
+    uint8_t ref[AX25_ADDR_LEN];
+
+    ax25_put_addr(ref, call, ssid, 0);
+    return memcmp(addr, ref, AX25_CALLSIGN_MAX_LEN) == 0 && ((addr[6] ^ ref[6]) & 0x1E) == 0;
 }
 
 /**
@@ -52,14 +135,9 @@ size_t ax25_create_addr_field(uint8_t *out, const uint8_t *dest_addr, uint8_t de
  * @param len size of the buffer
  * @return the FCS of the buffer
  */
-uint16_t ax25_fcs(uint8_t *buffer, size_t len)
+uint16_t ax25_fcs(const uint8_t *buffer, size_t len)
 {
-    uint16_t fcs = 0xFFFF;
-    while (len--)
-    {
-        fcs = (fcs >> 8) ^ crc16_ccitt_table_reverse[(fcs ^ *buffer++) & 0xFF];
-    }
-    return fcs ^ 0xFFFF;
+    return ax25_fcs_update(0xFFFF, buffer, len) ^ 0xFFFF;
 }
 
 /**
@@ -75,6 +153,8 @@ uint16_t ax25_fcs(uint8_t *buffer, size_t len)
  */
 size_t ax25_create_frame(uint8_t *out, const uint8_t *info, size_t info_len, ax25_frame_type_t type, uint8_t *addr, size_t addr_len, uint16_t ctrl, size_t ctrl_len)
 {
+    AX25_PROF_START(t0);
+
     // returns if info length passed is greater than allowed frame size
     if (info_len > AX25_MAX_FRAME_LEN)
     {
@@ -82,11 +162,12 @@ size_t ax25_create_frame(uint8_t *out, const uint8_t *info, size_t info_len, ax2
     }
 
     uint16_t i = 1; // index for out pointer
+    uint16_t fcs;
 
     /* adding initial flag*/
     out[0] = AX25_FLAG;
-    /* adding address*/
-    if (addr_len == AX25_MIN_ADDR_LEN || addr_len == AX25_MAX_ADDR_LEN)
+    /* adding address, with up to AX25_MAX_DIGIS digipeaters */
+    if (addr_len >= AX25_MIN_ADDR_LEN && addr_len <= AX25_MAX_ADDR_LEN && addr_len % AX25_ADDR_LEN == 0)
     {
         for (int j=0;j<addr_len;j++)
         {
@@ -125,6 +206,9 @@ size_t ax25_create_frame(uint8_t *out, const uint8_t *info, size_t info_len, ax2
         out[i++] = 0xF0;
     }
 
+    /* The FCS covers the header emitted so far. Ignore the first flag byte */
+    fcs = ax25_fcs_update(0xFFFF, out + 1, i - 1);
+
     /* addign info into the out buffer */
 
     /*memcpy(out + i, info, info_len);
@@ -133,9 +217,8 @@ size_t ax25_create_frame(uint8_t *out, const uint8_t *info, size_t info_len, ax2
     {
         out[i++]=info[j];
     }
+    fcs = ax25_fcs_update(fcs, info, info_len) ^ 0xFFFF;
 
-    /* Compute the FCS. Ignore the first flag byte */
-    uint16_t fcs = ax25_fcs(out + 1, i - 1);
     /* The MS bits are sent first ONLY at the FCS field */
     out[i++] = (fcs >> 8) & 0xFF;
     out[i++] = fcs & 0xFF;
@@ -143,258 +226,1977 @@ size_t ax25_create_frame(uint8_t *out, const uint8_t *info, size_t info_len, ax2
     /* final flag */
     out[i++] = AX25_FLAG;
 
-    
-
+    AX25_PROF_END(AX25_PROF_FRAME, t0);
     return i;
 }
 
-ax25_encode_status_t ax25_bit_stuffing(uint8_t *out, size_t *out_len, const uint8_t *buffer, const size_t buffer_len)
+/**
+ * Prepares an encoder context. The address field and its contribution to
+ * the FCS are computed once here and reused for every frame.
+ * @param ctx the encoder context
+ * @param dest_addr the destination callsign address
+ * @param dest_ssid the destination SSID
+ * @param src_addr the callsign of the source
+ * @param src_ssid the source SSID
+ */
+void ax25_enc_init(ax25_enc_ctx_t *ctx, const uint8_t *dest_addr, uint8_t dest_ssid, const uint8_t *src_addr, uint8_t src_ssid)
 {
-    uint8_t bit;
-    uint8_t prev_bit = 0;
-    size_t out_idx = 0;
-    size_t cont_1 = 0;
-    size_t total_cont_1 = 0;
-    size_t i;
+    AX25_PROF_START(t0);
 
-    /* Leading FLAG field does not need bit stuffing */
-    for (int j=0;j<8*sizeof(uint8_t);j++)
-    {
-        out[out_idx++]=AX25_SYNC_FLAG_MAP_BIN[j];
-    }
-    /*
-    memcpy(out, AX25_SYNC_FLAG_MAP_BIN, 8 * sizeof(uint8_t));
-    out_idx = 8;
-    */
-    /* Skip the leading and trailing FLAG field */
-    buffer++;
-    for (i = 0; i < 8 * (buffer_len - 2); i++)
-    {
-        bit = (buffer[i / 8] >> (i % 8)) & 0x1;
-        out[out_idx++] = bit;
-
-        /* Check if bit stuffing should be applied */
-        if (bit & prev_bit)
-        {
-            cont_1++;
-            total_cont_1++;
-            if (cont_1 == 4)
-            {
-                out[out_idx++] = 0;
-                cont_1 = 0;
-            }
-        }
-        else
-        {
-            cont_1 = total_cont_1 = 0;
-        }
-        prev_bit = bit;
+    ctx->addr_len = ax25_create_addr_field(ctx->addr, dest_addr, dest_ssid, src_addr, src_ssid);
+    ctx->addr_fcs = ax25_fcs_update(0xFFFF, ctx->addr, ctx->addr_len);
+    ctx->line = AX25_LINE_NONE;
+    AX25_PROF_END(AX25_PROF_ADDR, t0);
+}
 
-        /*
-         * If the total number of continuous 1's is 15 the the frame should be
-         * dropped
-         */
-        if (total_cont_1 >= 14)
-        {
-            return AX25_ENC_FAIL;
-        }
-    }
+/**
+ * Prepares an encoder context for frames relayed by digipeaters
+ * @param ctx the encoder context
+ * @param dest_addr the destination callsign address
+ * @param dest_ssid the destination SSID
+ * @param src_addr the callsign of the source
+ * @param src_ssid the source SSID
+ * @param digis the digipeaters, in the order the frame goes through them
+ * @param ndigis number of digipeaters, up to AX25_MAX_DIGIS
+ * @return AX25_ENC_FAIL if there are too many digipeaters
+ */
+ax25_encode_status_t ax25_enc_init_path(ax25_enc_ctx_t *ctx, const uint8_t *dest_addr, uint8_t dest_ssid, const uint8_t *src_addr, uint8_t src_ssid, const ax25_digi_t *digis, size_t ndigis)
+{
+    AX25_PROF_START(t0);
+    size_t addr_len = ax25_create_addr_path(ctx->addr, dest_addr, dest_ssid, src_addr, src_ssid, digis, ndigis);
 
-    /* Trailing FLAG field does not need bit stuffing */
-    for (int j=0;j<8*sizeof(uint8_t);j++)
+    if (addr_len == 0)
     {
-        out[out_idx++]=AX25_SYNC_FLAG_MAP_BIN[j];
+        return AX25_ENC_FAIL;
     }
-    /*
-    memcpy(out + out_idx, AX25_SYNC_FLAG_MAP_BIN, 8 * sizeof(uint8_t));
-    out_idx += 8;*/
-
-    *out_len = out_idx;
+    ctx->addr_len = addr_len;
+    ctx->addr_fcs = ax25_fcs_update(0xFFFF, ctx->addr, ctx->addr_len);
+    ctx->line = AX25_LINE_NONE;
+    AX25_PROF_END(AX25_PROF_ADDR, t0);
     return AX25_ENC_OK;
 }
 
 /**
- * the main function to be called to create ax25 frames
- * @param out is the buffer to hold multiple ax.25 frames
- * @param in data to be encoded
- * @param len length of data to be encoded
- * @param type ax25 frame type (I,S,U,UI frame)
+ * Selects the line coding applied to the stuffed bitstream of the frames
+ * encoded with this context. Each frame is coded from a reset coder, after
+ * AX25_LINE_SYNC_FLAGS() extra flags for the receiver to lock on. Streams
+ * of frames can instead be encoded with AX25_LINE_NONE and coded with
+ * ax25_line_code() by a coder of the transmitter.
+ * @param ctx the encoder context
+ * @param line AX25_LINE_NONE or a combination of AX25_LINE_NRZI and
+ * AX25_LINE_G3RUH
  */
-int32_t ax25_encode(uint8_t *out, const uint8_t *in, size_t inlen, ax25_frame_type_t type)
+void ax25_enc_set_line_coding(ax25_enc_ctx_t *ctx, uint8_t line)
 {
+    ctx->line = line;
+}
+
 /**
- * Future_parikshit_problems : the out buffer is 1d or 2d 
-*/
-    uint8_t *addr = (uint8_t *)malloc(sizeof(uint8_t) * AX25_MAX_ADDR_LEN);
-    size_t addrlen = ax25_create_addr_field(addr, GRD_CALLSIGN, GRD_SSID, SAT_CALLSIGN, SAT_SSID);
+ * Prepares a bit stuffing engine writing into a packed bitstream
+ * @param s the stuffer state
+ * @param out the output buffer. Bits are packed MSB first in transmission
+ * order
+ * @param out_cap size of out in bytes
+ */
+void ax25_stuffer_init(ax25_stuffer_t *s, uint8_t *out, size_t out_cap)
+{
+    s->out = out;
+    s->out_cap = out_cap;
+    s->out_idx = 0;
+    s->acc = 0;
+    s->acc_bits = 0;
+    s->cont_1 = 0;
+    ax25_line_init(&s->coder, AX25_LINE_NONE);
+}
+
+/*
+ * NRZI encodes a byte, MS bit first: a 0 is sent as a level transition.
+ * The running XOR of the inverted bits gives all eight levels at once.
+ */
+static inline uint8_t ax25_nrzi_encode(uint8_t *level, uint8_t b)
+{
+    uint8_t y = ~b;
 
-    uint8_t ctrl;
-    size_t ctrllen;
+    y ^= y >> 1;
+    y ^= y >> 2;
+    y ^= y >> 4;
+    if (*level)
+    {
+        y = ~y;
+    }
+    *level = y & 0x1;
+    return y;
+}
 
-    ax25_encode_status_t status;
+static inline uint8_t ax25_nrzi_decode(uint8_t *level, uint8_t y)
+{
+    uint8_t prev = *level;
 
-    uint8_t interm_buffer[AX25_MAX_FRAME_LEN] = {0};
-    uint8_t tmp_send_buf[AX25_MAX_FRAME_LEN * 8 + AX25_MAX_FRAME_LEN] = {0};
-    uint32_t framelen = 0;
-    size_t ret_len;
-    size_t pad_bits = 0;
+    *level = y & 0x1;
+    return ~(y ^ ((y >> 1) | (prev << 7)));
+}
 
-    /* FUTURE_SHASH_PROBLEMS : 1. create a control field function , 2. add ctrl for other frames */
-    if (type == AX25_UI_FRAME)
+/*
+ * G3RUH x^17 + x^12 + 1 self synchronising scrambler. Both taps are more
+ * than 8 bits back, so a whole byte is scrambled from the register at once.
+ * lfsr holds the past line bits, the latest one in bit 0.
+ */
+static inline uint8_t ax25_g3ruh_scramble(uint32_t *lfsr, uint8_t b)
+{
+    uint8_t y = b ^ (uint8_t)(*lfsr >> 4) ^ (uint8_t)(*lfsr >> 9);
+
+    *lfsr = (*lfsr << 8) | y;
+    return y;
+}
+
+static inline uint8_t ax25_g3ruh_descramble(uint32_t *lfsr, uint8_t y)
+{
+    uint8_t b = y ^ (uint8_t)(*lfsr >> 4) ^ (uint8_t)(*lfsr >> 9);
+
+    *lfsr = (*lfsr << 8) | y;
+    return b;
+}
+
+/* Line coding of a stuffed byte: NRZI first, then the scrambler */
+static inline uint8_t ax25_line_encode(ax25_line_coder_t *coder, uint8_t b)
+{
+    if (coder->line & AX25_LINE_NRZI)
+    {
+        b = ax25_nrzi_encode(&coder->nrzi_level, b);
+    }
+    if (coder->line & AX25_LINE_G3RUH)
     {
-        ctrl = AX25_CTRL_UI;
-        ctrllen = AX25_MIN_CTRL_LEN;
+        b = ax25_g3ruh_scramble(&coder->lfsr, b);
     }
+    return b;
+}
+
+/**
+ * Resets a line coder
+ * @param coder the line coder
+ * @param line AX25_LINE_NONE or a combination of AX25_LINE_NRZI and
+ * AX25_LINE_G3RUH
+ */
+void ax25_line_init(ax25_line_coder_t *coder, uint8_t line)
+{
+    coder->line = line;
+    coder->nrzi_level = 0;
+    coder->lfsr = 0;
+}
 
-    /*immidiate_shash_update: add as to make multiple, use interm buffer */
-    framelen = ax25_create_frame(interm_buffer, in, inlen, type, addr, addrlen, ctrl, ctrllen);
+/**
+ * Line codes a stuffed bitstream, encoded with AX25_LINE_NONE. A
+ * transmitter passes everything it sends through the same coder, so the
+ * coder state runs on across frames and a frame kept for retransmission
+ * is coded again each time it goes out.
+ * @param coder the line coder of the transmitter
+ * @param out receives the line bits, may be in
+ * @param in the stuffed bitstream
+ * @param len number of bytes in in
+ */
+void ax25_line_code(ax25_line_coder_t *coder, uint8_t *out, const uint8_t *in, size_t len)
+{
+    size_t i;
 
-    for (int i = 0; i < framelen; i++)
+    if (coder->line == AX25_LINE_NONE)
     {
-        printf("\n %x : %c : %d", interm_buffer[i], interm_buffer[i], interm_buffer[i]);
+        if (out != in)
+        {
+            memcpy(out, in, len);
+        }
+        return;
     }
-
-    status = ax25_bit_stuffing(tmp_send_buf, &ret_len, interm_buffer, framelen);
-    if (status != AX25_ENC_OK)
+    for (i = 0; i < len; i++)
     {
-        return -1;
+        out[i] = ax25_line_encode(coder, in[i]);
     }
+}
 
-    memset(out, 0, ret_len / 8 * sizeof(uint8_t));
-    /* Pack now the bits into full bytes */
-    for (int i = 0; i < ret_len; i++)
+/* Writes the whole bytes held in acc, as long as out has room */
+static inline void ax25_stuffer_drain(ax25_stuffer_t *s)
+{
+    while (s->acc_bits >= 8 && s->out_idx < s->out_cap)
     {
-        out[i / 8] |= tmp_send_buf[i] << (7 - (i % 8));
+        s->acc_bits -= 8;
+        s->out[s->out_idx] = (uint8_t)(s->acc >> s->acc_bits);
+        if (s->coder.line)
+        {
+            s->out[s->out_idx] = ax25_line_encode(&s->coder, s->out[s->out_idx]);
+        }
+        s->out_idx++;
     }
-    pad_bits = 8 - (ret_len % 8);
-    ret_len += pad_bits;
-    out[ret_len / 8] &= (0xFF << pad_bits);
+}
+
+/* Appends n bits (first transmitted bit is the MSB of v) and flushes whole bytes */
+static inline void ax25_stuffer_push(ax25_stuffer_t *s, uint32_t v, uint8_t n)
+{
+    s->acc = (s->acc << n) | v;
+    s->acc_bits += n;
+    ax25_stuffer_drain(s);
+}
 
-    return ret_len / 8;
+/**
+ * Emits an AX.25 flag. Flags are never bit stuffed and reset the run of 1's
+ * @param s the stuffer state
+ * @return AX25_ENC_FAIL if the output buffer is exhausted
+ */
+ax25_encode_status_t ax25_stuffer_put_flag(ax25_stuffer_t *s)
+{
+    if (s->acc_bits >= 8)
+    {
+        return AX25_ENC_FAIL;
+    }
+    ax25_stuffer_push(s, AX25_FLAG, 8);
+    s->cont_1 = 0;
+    return AX25_ENC_OK;
 }
 
-ax25_decode_status_t ax25_decode(uint8_t *out, size_t *out_len, const uint8_t *ax25_frame, size_t len)
+/**
+ * Opens a frame whose line coder starts from its reset state: the sync
+ * flags of the line coding, then the opening flag
+ * @param s the stuffer state
+ * @param line AX25_LINE_xxx coding of the output
+ * @return AX25_ENC_FAIL if the output buffer is exhausted
+ */
+ax25_encode_status_t ax25_stuffer_open(ax25_stuffer_t *s, uint8_t line)
 {
-    size_t i;
-    size_t frame_start = UINT_MAX;
-    size_t frame_stop = UINT_MAX;
-    uint8_t res;
-    size_t cont_1 = 0;
-    size_t received_bytes = 0;
-    size_t bit_cnt = 0;
-    uint8_t decoded_byte = 0x0;
-    uint16_t fcs;
-    uint16_t recv_fcs;
+    int i;
 
-    /* Start searching for the SYNC flag */
-    for (i = 0; i < len - sizeof(AX25_SYNC_FLAG_MAP_BIN); i++)
+    ax25_line_init(&s->coder, line);
+    for (i = 0; i <= AX25_LINE_SYNC_FLAGS(line); i++)
     {
-        res = (AX25_SYNC_FLAG_MAP_BIN[0] ^ ax25_frame[i]) | (AX25_SYNC_FLAG_MAP_BIN[1] ^ ax25_frame[i + 1]) | (AX25_SYNC_FLAG_MAP_BIN[2] ^ ax25_frame[i + 2]) | (AX25_SYNC_FLAG_MAP_BIN[3] ^ ax25_frame[i + 3]) | (AX25_SYNC_FLAG_MAP_BIN[4] ^ ax25_frame[i + 4]) | (AX25_SYNC_FLAG_MAP_BIN[5] ^ ax25_frame[i + 5]) | (AX25_SYNC_FLAG_MAP_BIN[6] ^ ax25_frame[i + 6]) | (AX25_SYNC_FLAG_MAP_BIN[7] ^ ax25_frame[i + 7]);
-        /* Found it! */
-        if (res == 0)
+        if (ax25_stuffer_put_flag(s) != AX25_ENC_OK)
         {
-            printf("AX Start found at %d\n", i);
-            frame_start = i;
-            break;
+            return AX25_ENC_FAIL;
         }
     }
+    return AX25_ENC_OK;
+}
 
-    /* We failed to find the SYNC flag */
-    if (frame_start == UINT_MAX)
-    {
-        // std::cout << "Frame start was not found" << std::endl;
-        printf("AX Frame start was not found\n");
-        return AX25_DEC_FAIL;
-    }
+/*
+ * Bit stuffs bytes until the output buffer is full
+ * @return the number of bytes of buffer consumed
+ */
+static size_t ax25_stuffer_feed(ax25_stuffer_t *s, const uint8_t *buffer, size_t len)
+{
+    uint32_t x;
+    uint8_t b;
+    uint8_t bit;
+    uint8_t cont_1 = s->cont_1;
+    size_t i;
+    int j;
 
-    for (i = frame_start + sizeof(AX25_SYNC_FLAG_MAP_BIN);
-         i < len - sizeof(AX25_SYNC_FLAG_MAP_BIN) + 1; i++)
+    for (i = 0; i < len; i++)
     {
-        /* Check if we reached the frame end */
-        res = (AX25_SYNC_FLAG_MAP_BIN[0] ^ ax25_frame[i]) | (AX25_SYNC_FLAG_MAP_BIN[1] ^ ax25_frame[i + 1]) | (AX25_SYNC_FLAG_MAP_BIN[2] ^ ax25_frame[i + 2]) | (AX25_SYNC_FLAG_MAP_BIN[3] ^ ax25_frame[i + 3]) | (AX25_SYNC_FLAG_MAP_BIN[4] ^ ax25_frame[i + 4]) | (AX25_SYNC_FLAG_MAP_BIN[5] ^ ax25_frame[i + 5]) | (AX25_SYNC_FLAG_MAP_BIN[6] ^ ax25_frame[i + 6]) | (AX25_SYNC_FLAG_MAP_BIN[7] ^ ax25_frame[i + 7]);
-        /* Found it! */
-        if (res == 0)
+        if (s->acc_bits >= 8)
         {
-            printf("AX Stop found at %d\n", i);
-            frame_stop = i;
             break;
         }
+        b = buffer[i];
 
-        if (ax25_frame[i])
+        /*
+         * Prepend the pending run of 1's to the byte. If no five consecutive
+         * 1's appear, the byte goes out as is in a single shot.
+         */
+        x = ((uint32_t)b << cont_1) | ((1U << cont_1) - 1);
+        if ((x & (x >> 1) & (x >> 2) & (x >> 3) & (x >> 4)) == 0)
         {
-            cont_1++;
-            decoded_byte |= 1 << bit_cnt;
-            bit_cnt++;
+            ax25_stuffer_push(s, reverse_byte(b), 8);
+            for (cont_1 = 0; b & (0x80 >> cont_1); cont_1++)
+                ;
+            continue;
         }
-        else
+
+        /* Slow path, this byte needs stuffing */
+        for (j = 0; j < 8; j++)
         {
-            /* If 5 consecutive 1's drop the extra zero*/
-            if (cont_1 >= 5)
+            bit = (b >> j) & 0x1;
+            ax25_stuffer_push(s, bit, 1);
+            if (bit)
             {
-                cont_1 = 0;
+                if (++cont_1 == 5)
+                {
+                    ax25_stuffer_push(s, 0, 1);
+                    cont_1 = 0;
+                }
             }
             else
             {
-                bit_cnt++;
                 cont_1 = 0;
             }
         }
+    }
+    s->cont_1 = cont_1;
+    return i;
+}
 
-        /* Fill the fully constructed byte */
-        if (bit_cnt == 8)
-        {
-            out[received_bytes++] = decoded_byte;
-            bit_cnt = 0;
-            decoded_byte = 0x0;
-        }
+/**
+ * Bit stuffs a byte buffer straight into the packed output bitstream.
+ * Bytes are sent LSB first and a 0 is inserted after every five
+ * consecutive 1's. The run of 1's is kept in the state, so a frame can be
+ * fed in several pieces.
+ * @param s the stuffer state
+ * @param buffer the bytes to be stuffed
+ * @param len number of bytes in buffer
+ * @return AX25_ENC_FAIL if the output buffer is exhausted
+ */
+ax25_encode_status_t ax25_stuffer_put(ax25_stuffer_t *s, const uint8_t *buffer, size_t len)
+{
+    return ax25_stuffer_feed(s, buffer, len) == len ? AX25_ENC_OK : AX25_ENC_FAIL;
+}
+
+/**
+ * Bit stuffs a frame given without its FCS, then its FCS and the closing
+ * flag. The opening flag, and any flags before it, are up to the caller.
+ * @param s the stuffer state
+ * @param frame the frame, from the address field to the info field
+ * @param len length of frame
+ * @return AX25_ENC_FAIL if the output buffer is exhausted
+ */
+ax25_encode_status_t ax25_stuffer_put_frame(ax25_stuffer_t *s, const uint8_t *frame, size_t len)
+{
+    uint8_t fcs_field[sizeof(uint16_t)];
+    uint16_t fcs;
+
+    AX25_PROF_START(t_fcs);
+    fcs = ax25_fcs(frame, len);
+    AX25_PROF_END(AX25_PROF_FCS, t_fcs);
+    /* The MS bits are sent first ONLY at the FCS field */
+    fcs_field[0] = (fcs >> 8) & 0xFF;
+    fcs_field[1] = fcs & 0xFF;
+    if (ax25_stuffer_put(s, frame, len) != AX25_ENC_OK
+        || ax25_stuffer_put(s, fcs_field, sizeof(fcs_field)) != AX25_ENC_OK)
+    {
+        return AX25_ENC_FAIL;
+    }
+    return ax25_stuffer_put_flag(s);
+}
+
+/**
+ * Flushes the last, partially filled byte. The unused LS bits are set to 0.
+ * @param s the stuffer state
+ * @param out_bits if not NULL, holds the number of valid bits in the output
+ * @return AX25_ENC_FAIL if the output buffer could not hold the bitstream
+ */
+ax25_encode_status_t ax25_stuffer_finish(ax25_stuffer_t *s, size_t *out_bits)
+{
+    uint8_t pad_bits = (8 - s->acc_bits % 8) % 8;
+    size_t nbits = s->out_idx * 8 + s->acc_bits;
+
+    if (pad_bits)
+    {
+        ax25_stuffer_push(s, 0, pad_bits);
+    }
+    if (s->acc_bits)
+    {
+        return AX25_ENC_FAIL;
+    }
+    if (out_bits)
+    {
+        *out_bits = nbits;
     }
+    return AX25_ENC_OK;
+}
+
+/**
+ * Bit stuffs a frame created by ax25_create_frame()
+ * @param out the packed output bitstream
+ * @param out_len the number of bits written to out
+ * @param buffer the frame, including the leading and trailing flags
+ * @param buffer_len length of the frame
+ */
+ax25_encode_status_t ax25_bit_stuffing(uint8_t *out, size_t *out_len, const uint8_t *buffer, const size_t buffer_len)
+{
+    ax25_stuffer_t s;
+
+    ax25_stuffer_init(&s, out, SIZE_MAX);
+    /* Leading and trailing FLAG fields do not need bit stuffing */
+    ax25_stuffer_put_flag(&s);
+    ax25_stuffer_put(&s, buffer + 1, buffer_len - 2);
+    ax25_stuffer_put_flag(&s);
+    return ax25_stuffer_finish(&s, out_len);
+}
+
+/**
+ * Returns the worst case size of an encoded frame, i.e. when every fifth
+ * bit needs stuffing
+ * @param info_len length of the info field
+ * @return the size in bytes that ax25_encode_into() may need
+ */
+size_t ax25_encoded_size_max(size_t info_len)
+{
+    return AX25_ENCODED_SIZE_MAX(info_len);
+}
 
-    if (frame_stop == UINT_MAX || received_bytes < AX25_MIN_ADDR_LEN)
+/* Picks the control field for a frame type */
+static ax25_encode_status_t ax25_ctrl_for_type(ax25_frame_type_t type, uint16_t *ctrl, size_t *ctrl_len)
+{
+    /*
+     * I and S frames need sequence numbers and U frames a command: they
+     * are built with ax25_ctrl_i/s/u() and ax25_encode_ctrl_iov()
+     */
+    if (type == AX25_UI_FRAME)
     {
-        printf("AX Wrong frame size\n");
-        return AX25_DEC_FAIL;
+        *ctrl = AX25_CTRL_UI;
+        *ctrl_len = AX25_MIN_CTRL_LEN;
+        return AX25_ENC_OK;
     }
+    return AX25_ENC_FAIL;
+}
 
-    /* Now check the CRC */
-    fcs = ax25_fcs(out, received_bytes - sizeof(uint16_t));
-    recv_fcs = (((uint16_t)out[received_bytes - 2]) << 8) | out[received_bytes - 1];
+/**
+ * Builds the control field of an I frame
+ * @param ns N(S), the sequence number of the frame
+ * @param nr N(R), the next sequence number expected from the peer
+ * @param pf the P/F bit
+ * @param mod128 1 for modulo 128 sequence numbers, 0 for modulo 8
+ * @param ctrl_len receives the length of the control field
+ * @return the control field, LS byte sent first
+ */
+uint16_t ax25_ctrl_i(uint8_t ns, uint8_t nr, uint8_t pf, uint8_t mod128, size_t *ctrl_len)
+{
+    if (mod128)
+    {
+        *ctrl_len = AX25_MAX_CTRL_LEN;
+        return (uint16_t)((ns & 0x7F) << 1) | (uint16_t)((((nr & 0x7F) << 1) | (pf ? AX25_CTRL_PF_EXT : 0)) << 8);
+    }
+    *ctrl_len = AX25_MIN_CTRL_LEN;
+    return ((nr & 0x7) << 5) | (pf ? AX25_CTRL_PF : 0) | ((ns & 0x7) << 1);
+}
 
-    if (fcs != recv_fcs)
+/**
+ * Builds the control field of an S frame
+ * @param code AX25_CTRL_RR, AX25_CTRL_RNR, AX25_CTRL_REJ or AX25_CTRL_SREJ
+ * @param nr N(R), the next sequence number expected from the peer
+ * @param pf the P/F bit
+ * @param mod128 1 for modulo 128 sequence numbers, 0 for modulo 8
+ * @param ctrl_len receives the length of the control field
+ * @return the control field, LS byte sent first
+ */
+uint16_t ax25_ctrl_s(uint8_t code, uint8_t nr, uint8_t pf, uint8_t mod128, size_t *ctrl_len)
+{
+    if (mod128)
     {
-        printf("AX Wrong FCS\n");
-        return AX25_DEC_FAIL;
+        *ctrl_len = AX25_MAX_CTRL_LEN;
+        return code | (uint16_t)((((nr & 0x7F) << 1) | (pf ? AX25_CTRL_PF_EXT : 0)) << 8);
     }
+    *ctrl_len = AX25_MIN_CTRL_LEN;
+    return ((nr & 0x7) << 5) | (pf ? AX25_CTRL_PF : 0) | code;
+}
 
-    *out_len = received_bytes - sizeof(uint16_t);
-    return AX25_DEC_OK;
+/**
+ * Builds the control field of a U frame, always a single byte
+ * @param code AX25_CTRL_SABM, AX25_CTRL_UA, ...
+ * @param pf the P/F bit
+ * @param ctrl_len receives the length of the control field
+ * @return the control field
+ */
+uint16_t ax25_ctrl_u(uint8_t code, uint8_t pf, size_t *ctrl_len)
+{
+    *ctrl_len = AX25_MIN_CTRL_LEN;
+    return code | (pf ? AX25_CTRL_PF : 0);
 }
 
-uint32_t ax25_recv(uint8_t *out, const uint8_t *in, size_t len)
+/*
+ * Builds the control and PID bytes that follow the address field. Only I
+ * and UI frames have a PID.
+ * @return the number of bytes written to hdr
+ */
+static size_t ax25_ctrl_hdr(uint8_t *hdr, uint16_t ctrl, size_t ctrl_len)
 {
-    size_t i;
-    size_t decode_len;
-    ax25_decode_status_t status;
-    uint8_t tmp_recv_buf[AX25_MAX_FRAME_LEN * 8 + AX25_MAX_FRAME_LEN] = {0};
+    size_t hdr_len = 0;
 
-    /* Apply one bit per byte for easy decoding */
-    for (i = 0; i < len; i++)
+    hdr[hdr_len++] = (uint8_t)(ctrl & 0xFF);
+    if (ctrl_len == AX25_MAX_CTRL_LEN)
+    {
+        hdr[hdr_len++] = (uint8_t)((ctrl >> 8) & 0xFF);
+    }
+    /* as there is no layer 3 being used PID is set to 0xF0 */
+    if ((ctrl & 0x1) == 0 || (ctrl & ~AX25_CTRL_PF & 0xFF) == AX25_CTRL_UI)
     {
-        tmp_recv_buf[8 * i] = (in[i] >> 7) & 0x1;
-        tmp_recv_buf[8 * i + 1] = (in[i] >> 6) & 0x1;
-        tmp_recv_buf[8 * i + 2] = (in[i] >> 5) & 0x1;
-        tmp_recv_buf[8 * i + 3] = (in[i] >> 4) & 0x1;
-        tmp_recv_buf[8 * i + 4] = (in[i] >> 3) & 0x1;
-        tmp_recv_buf[8 * i + 5] = (in[i] >> 2) & 0x1;
-        tmp_recv_buf[8 * i + 6] = (in[i] >> 1) & 0x1;
-        tmp_recv_buf[8 * i + 7] = in[i] & 0x1;
+        hdr[hdr_len++] = 0xF0;
     }
+    return hdr_len;
+}
+
+/*
+ * Builds the control and PID bytes of a frame type
+ * @return the number of bytes written to hdr, 0 if type is not supported
+ */
+static size_t ax25_create_ctrl_pid(uint8_t *hdr, ax25_frame_type_t type)
+{
+    size_t ctrl_len;
+    uint16_t ctrl;
 
-    /* Perform the actual decoding */
-    status = ax25_decode(out, &decode_len, tmp_recv_buf, len * 8);
-    if (status != AX25_DEC_OK)
+    if (ax25_ctrl_for_type(type, &ctrl, &ctrl_len) != AX25_ENC_OK)
     {
-        return -1;
+        return 0;
     }
-    return (ssize_t)decode_len;
+    return ax25_ctrl_hdr(hdr, ctrl, ctrl_len);
 }
 
+/* Encodes a frame from its control/PID bytes and scattered info field */
+static int32_t ax25_encode_hdr_iov(const ax25_enc_ctx_t *ctx, uint8_t *out, size_t out_cap, const uint8_t *hdr, size_t hdr_len, const ax25_iovec_t *iov, size_t iovcnt)
+{
+    ax25_stuffer_t s;
+    uint8_t fcs_field[sizeof(uint16_t)];
+    size_t info_len = 0;
+    uint16_t fcs;
+    size_t nbits;
+    size_t i;
+
+    for (i = 0; i < iovcnt; i++)
+    {
+        info_len += iov[i].len;
+    }
+    if (info_len > AX25_MAX_FRAME_LEN)
+    {
+        return -1;
+    }
+
+    AX25_PROF_START(t_fcs);
+    fcs = ax25_fcs_update(ctx->addr_fcs, hdr, hdr_len);
+    for (i = 0; i < iovcnt; i++)
+    {
+        fcs = ax25_fcs_update(fcs, iov[i].base, iov[i].len);
+    }
+    fcs ^= 0xFFFF;
+    AX25_PROF_END(AX25_PROF_FCS, t_fcs);
+
+    AX25_PROF_START(t_stuff);
+    ax25_stuffer_init(&s, out, out_cap);
+    if (ax25_stuffer_open(&s, ctx->line) != AX25_ENC_OK
+        || ax25_stuffer_put(&s, ctx->addr, ctx->addr_len) != AX25_ENC_OK
+        || ax25_stuffer_put(&s, hdr, hdr_len) != AX25_ENC_OK)
+    {
+        return -1;
+    }
+    for (i = 0; i < iovcnt; i++)
+    {
+        if (ax25_stuffer_put(&s, iov[i].base, iov[i].len) != AX25_ENC_OK)
+        {
+            return -1;
+        }
+    }
+
+    /* The MS bits are sent first ONLY at the FCS field */
+    fcs_field[0] = (fcs >> 8) & 0xFF;
+    fcs_field[1] = fcs & 0xFF;
+    if (ax25_stuffer_put(&s, fcs_field, sizeof(fcs_field)) != AX25_ENC_OK
+        || ax25_stuffer_put_flag(&s) != AX25_ENC_OK)
+    {
+        return -1;
+    }
+    AX25_PROF_END(AX25_PROF_STUFF, t_stuff);
+
+    AX25_PROF_START(t_pack);
+    if (ax25_stuffer_finish(&s, &nbits) != AX25_ENC_OK)
+    {
+        return -1;
+    }
+    AX25_PROF_END(AX25_PROF_PACK, t_pack);
+    return (int32_t)((nbits + 7) / 8);
+}
+
+/**
+ * Encodes a frame whose info field is scattered over several buffers
+ * straight into a packed, bit stuffed bitstream. Nothing is allocated and
+ * no intermediate copy of the frame is made: the header, every info
+ * segment and the FCS are hashed and stuffed as they are emitted.
+ * @param ctx the encoder context holding the address field
+ * @param out the output bitstream
+ * @param out_cap size of out. ax25_encoded_size_max() is always enough
+ * @param iov the segments forming the info field, in order
+ * @param iovcnt number of segments in iov
+ * @param type ax25 frame type (I,S,U,UI frame)
+ * @return the number of bytes written to out, or -1
+ */
+int32_t ax25_encode_iov(const ax25_enc_ctx_t *ctx, uint8_t *out, size_t out_cap, const ax25_iovec_t *iov, size_t iovcnt, ax25_frame_type_t type)
+{
+    uint8_t hdr[AX25_MAX_CTRL_LEN + 1];
+    size_t hdr_len;
+
+    hdr_len = ax25_create_ctrl_pid(hdr, type);
+    if (hdr_len == 0)
+    {
+        return -1;
+    }
+    return ax25_encode_hdr_iov(ctx, out, out_cap, hdr, hdr_len, iov, iovcnt);
+}
+
+/**
+ * Encodes a frame of any type from its control field, built with
+ * ax25_ctrl_i(), ax25_ctrl_s() or ax25_ctrl_u(). I and UI frames get the
+ * PID; give S and U frames, other than FRMR, no info field.
+ * @param ctx the encoder context holding the address field
+ * @param out the output bitstream
+ * @param out_cap size of out. ax25_encoded_size_max() is always enough
+ * @param ctrl the control field, LS byte sent first
+ * @param ctrl_len length of the control field
+ * @param iov the segments forming the info field, in order
+ * @param iovcnt number of segments in iov
+ * @return the number of bytes written to out, or -1
+ */
+int32_t ax25_encode_ctrl_iov(const ax25_enc_ctx_t *ctx, uint8_t *out, size_t out_cap, uint16_t ctrl, size_t ctrl_len, const ax25_iovec_t *iov, size_t iovcnt)
+{
+    uint8_t hdr[AX25_MAX_CTRL_LEN + 1];
+
+    if (ctrl_len != AX25_MIN_CTRL_LEN && ctrl_len != AX25_MAX_CTRL_LEN)
+    {
+        return -1;
+    }
+    return ax25_encode_hdr_iov(ctx, out, out_cap, hdr, ax25_ctrl_hdr(hdr, ctrl, ctrl_len), iov, iovcnt);
+}
+
+/**
+ * Bit stuffs a complete frame, FCS included, as it is. Used to send again
+ * a received frame without computing its FCS.
+ * @param out the output bitstream
+ * @param out_cap size of out. AX25_MAX_ENCODED_LEN is always enough
+ * @param frame the frame, from the address field to the FCS
+ * @param len length of frame
+ * @param line AX25_LINE_xxx coding of the output
+ * @return the number of bytes written to out, or -1
+ */
+int32_t ax25_encode_raw(uint8_t *out, size_t out_cap, const uint8_t *frame, size_t len, uint8_t line)
+{
+    ax25_stuffer_t s;
+    size_t nbits;
+
+    if (len > AX25_MAX_RAW_FRAME_LEN)
+    {
+        return -1;
+    }
+    ax25_stuffer_init(&s, out, out_cap);
+    if (ax25_stuffer_open(&s, line) != AX25_ENC_OK
+        || ax25_stuffer_put(&s, frame, len) != AX25_ENC_OK
+        || ax25_stuffer_put_flag(&s) != AX25_ENC_OK
+        || ax25_stuffer_finish(&s, &nbits) != AX25_ENC_OK)
+    {
+        return -1;
+    }
+    return (int32_t)((nbits + 7) / 8);
+}
+
+/*
+ * Length of the address field at the start of a frame, which ends with the
+ * extension bit set. 0 if it is truncated or longer than AX25_MAX_ADDR_LEN.
+ */
+static size_t ax25_addr_field_len(const uint8_t *frame, size_t len)
+{
+    size_t addr_len = AX25_MIN_ADDR_LEN;
+
+    if (len < AX25_MIN_ADDR_LEN)
+    {
+        return 0;
+    }
+    while (!(frame[addr_len - 1] & 0x1))
+    {
+        addr_len += AX25_ADDR_LEN;
+        if (addr_len > AX25_MAX_ADDR_LEN || addr_len > len)
+        {
+            return 0;
+        }
+    }
+    return addr_len;
+}
+
+/**
+ * Splits the address field of a decoded frame. The path points into the
+ * frame, nothing is copied.
+ * @param frame the frame, with or without the FCS
+ * @param len length of frame
+ * @param path receives the addresses
+ * @return AX25_DEC_FAIL if the address field is truncated or too long
+ */
+ax25_decode_status_t ax25_parse_addr(const uint8_t *frame, size_t len, ax25_addr_path_t *path)
+{
+    size_t addr_len = ax25_addr_field_len(frame, len);
+    size_t i;
+
+    if (!addr_len)
+    {
+        return AX25_DEC_FAIL;
+    }
+    path->dest = frame;
+    path->src = frame + AX25_ADDR_LEN;
+    path->ndigis = (addr_len - AX25_MIN_ADDR_LEN) / AX25_ADDR_LEN;
+    path->next_digi = path->ndigis;
+    for (i = 0; i < path->ndigis; i++)
+    {
+        path->digi[i] = frame + AX25_MIN_ADDR_LEN + i * AX25_ADDR_LEN;
+        if (path->next_digi == path->ndigis && !(path->digi[i][6] & AX25_ADDR_H_BIT))
+        {
+            path->next_digi = i;
+        }
+    }
+    path->len = addr_len;
+    return AX25_DEC_OK;
+}
+
+/* Splits the control field and PID following an address field of addr_len bytes */
+static ax25_decode_status_t ax25_parse_ctrl_at(const uint8_t *frame, size_t len, size_t addr_len, uint8_t mod128, ax25_ctrl_info_t *info)
+{
+    size_t off;
+    uint8_t c;
+
+    if (!addr_len || addr_len >= len)
+    {
+        return AX25_DEC_FAIL;
+    }
+    memset(info, 0, sizeof(*info));
+    info->addr_len = addr_len;
+    info->command = (frame[6] & 0x80) && !(frame[13] & 0x80);
+    c = frame[addr_len];
+    off = addr_len + 1;
+
+    if ((c & 0x3) == 0x3)
+    {
+        info->type = ((c & ~AX25_CTRL_PF) == AX25_CTRL_UI) ? AX25_UI_FRAME : AX25_U_FRAME;
+        info->code = c & ~AX25_CTRL_PF;
+        info->pf = (c & AX25_CTRL_PF) != 0;
+    }
+    else
+    {
+        info->type = (c & 0x1) ? AX25_S_FRAME : AX25_I_FRAME;
+        if (mod128)
+        {
+            if (off >= len)
+            {
+                return AX25_DEC_FAIL;
+            }
+            info->ns = (c >> 1) & 0x7F;
+            info->nr = (frame[off] >> 1) & 0x7F;
+            info->pf = frame[off] & AX25_CTRL_PF_EXT;
+            off++;
+        }
+        else
+        {
+            info->ns = (c >> 1) & 0x7;
+            info->nr = (c >> 5) & 0x7;
+            info->pf = (c & AX25_CTRL_PF) != 0;
+        }
+        info->code = (info->type == AX25_S_FRAME) ? (c & 0x0F) : 0;
+    }
+    if (info->type == AX25_I_FRAME || info->type == AX25_UI_FRAME)
+    {
+        if (off >= len)
+        {
+            return AX25_DEC_FAIL;
+        }
+        off++;
+    }
+    info->info_off = off;
+    return AX25_DEC_OK;
+}
+
+/**
+ * Splits the header of a decoded frame: address field, control field and
+ * PID. Command and response are told apart by the C bits of the address
+ * field (AX.25 v2).
+ * @param frame the frame without the FCS
+ * @param len length of frame
+ * @param mod128 1 if I and S frames use modulo 128 sequence numbers
+ * @param info receives the fields
+ * @return AX25_DEC_FAIL if the header is truncated or malformed
+ */
+ax25_decode_status_t ax25_parse_ctrl(const uint8_t *frame, size_t len, uint8_t mod128, ax25_ctrl_info_t *info)
+{
+    return ax25_parse_ctrl_at(frame, len, ax25_addr_field_len(frame, len), mod128, info);
+}
+
+/**
+ * Splits a decoded frame into its address entries, control field, PID and
+ * info field without copying it
+ * @param frame the frame without the FCS, as returned by ax25_recv()
+ * @param len length of frame
+ * @param mod128 1 if I and S frames use modulo 128 sequence numbers
+ * @param view receives the fields, pointing into frame
+ * @return AX25_DEC_FAIL if the header is truncated or malformed
+ */
+ax25_decode_status_t ax25_parse_frame(const uint8_t *frame, size_t len, uint8_t mod128, ax25_frame_view_t *view)
+{
+    if (ax25_parse_addr(frame, len, &view->path) != AX25_DEC_OK
+        || ax25_parse_ctrl_at(frame, len, view->path.len, mod128, &view->ctrl) != AX25_DEC_OK)
+    {
+        return AX25_DEC_FAIL;
+    }
+    view->frame = frame;
+    view->len = len;
+    view->pid = NULL;
+    if (view->ctrl.type == AX25_I_FRAME || view->ctrl.type == AX25_UI_FRAME)
+    {
+        /* The PID is the last byte of the header */
+        view->pid = frame + view->ctrl.info_off - 1;
+    }
+    view->info = frame + view->ctrl.info_off;
+    view->info_len = len - view->ctrl.info_off;
+    return AX25_DEC_OK;
+}
+
+/**
+ * Decodes the callsign of an address of a received frame
+ * @param addr the address, e.g. view->path.src
+ * @param call receives the callsign without the padding spaces, NUL
+ * terminated. AX25_CALLSIGN_MAX_LEN + 1 bytes
+ * @return the length of the callsign
+ */
+size_t ax25_addr_call(const uint8_t *addr, char *call)
+{
+    size_t n = 0;
+    size_t i;
+
+    for (i = 0; i < AX25_CALLSIGN_MAX_LEN; i++)
+    {
+        call[i] = (char)(addr[i] >> 1);
+        if (call[i] != ' ')
+        {
+            n = i + 1;
+        }
+    }
+    call[n] = '\0';
+    return n;
+}
+
+/**
+ * Encodes a frame straight into a packed, bit stuffed bitstream, without
+ * any allocation
+ * @param ctx the encoder context holding the address field
+ * @param out the output bitstream
+ * @param out_cap size of out. ax25_encoded_size_max() is always enough
+ * @param in the info field
+ * @param inlen length of the info field
+ * @param type ax25 frame type (I,S,U,UI frame)
+ * @return the number of bytes written to out, or -1
+ */
+int32_t ax25_encode_into(const ax25_enc_ctx_t *ctx, uint8_t *out, size_t out_cap, const uint8_t *in, size_t inlen, ax25_frame_type_t type)
+{
+    ax25_iovec_t iov;
+
+    iov.base = in;
+    iov.len = inlen;
+    return ax25_encode_iov(ctx, out, out_cap, &iov, 1, type);
+}
+
+/**
+ * Prepares the transmission of a frame, pulled out with
+ * ax25_tx_next_chunk(). The info segments are referenced, not copied, and
+ * must stay valid until the transmission is done. AX25_PREAMBLE_LEN flags
+ * are sent before the frame and AX25_POSTAMBLE_LEN after it; the counts can
+ * be changed in tx before the first chunk is pulled. Set tx->source to send
+ * more frames back to back.
+ * @param tx the transmitter state
+ * @param ctx the encoder context holding the address field
+ * @param iov the segments forming the info field, in order
+ * @param iovcnt number of segments in iov, at most AX25_TX_MAX_IOV
+ * @param type ax25 frame type (I,S,U,UI frame)
+ * @return AX25_ENC_FAIL if the frame cannot be encoded
+ */
+ax25_encode_status_t ax25_tx_start(ax25_tx_t *tx, const ax25_enc_ctx_t *ctx, const ax25_iovec_t *iov, size_t iovcnt, ax25_frame_type_t type)
+{
+    if (ax25_tx_load(tx, ctx, iov, iovcnt, type) != AX25_ENC_OK)
+    {
+        return AX25_ENC_FAIL;
+    }
+    ax25_stuffer_init(&tx->s, NULL, 0);
+    tx->s.coder.line = ctx->line;
+    tx->flags_sent = 0;
+    tx->preamble_len = AX25_PREAMBLE_LEN;
+    tx->postamble_len = AX25_POSTAMBLE_LEN;
+    tx->source = NULL;
+    tx->source_user = NULL;
+    tx->state = AX25_TX_PREAMBLE;
+    return AX25_ENC_OK;
+}
+
+/**
+ * Sets up the fields of the next frame to send, leaving the bitstream state
+ * alone. Called by ax25_tx_start() and by tx->source callbacks, the frame
+ * then follows the previous one after a single shared flag.
+ * @param tx the transmitter state
+ * @param ctx the encoder context holding the address field
+ * @param iov the segments forming the info field, in order
+ * @param iovcnt number of segments in iov, at most AX25_TX_MAX_IOV
+ * @param type ax25 frame type (I,S,U,UI frame)
+ * @return AX25_ENC_FAIL if the frame cannot be encoded
+ */
+ax25_encode_status_t ax25_tx_load(ax25_tx_t *tx, const ax25_enc_ctx_t *ctx, const ax25_iovec_t *iov, size_t iovcnt, ax25_frame_type_t type)
+{
+    size_t hdr_len;
+    size_t info_len = 0;
+    size_t i;
+
+    hdr_len = ax25_create_ctrl_pid(tx->hdr, type);
+    if (iovcnt > AX25_TX_MAX_IOV || hdr_len == 0)
+    {
+        return AX25_ENC_FAIL;
+    }
+    tx->nparts = 0;
+    tx->parts[tx->nparts].base = ctx->addr;
+    tx->parts[tx->nparts++].len = ctx->addr_len;
+    tx->parts[tx->nparts].base = tx->hdr;
+    tx->parts[tx->nparts++].len = hdr_len;
+    for (i = 0; i < iovcnt; i++)
+    {
+        info_len += iov[i].len;
+        tx->parts[tx->nparts++] = iov[i];
+    }
+    if (info_len > AX25_MAX_FRAME_LEN)
+    {
+        return AX25_ENC_FAIL;
+    }
+    tx->parts[tx->nparts].base = tx->fcs_field;
+    tx->parts[tx->nparts++].len = sizeof(tx->fcs_field);
+
+    tx->fcs = ctx->addr_fcs;
+    tx->part = 0;
+    tx->part_off = 0;
+    return AX25_ENC_OK;
+}
+
+/* Stuffs the next bytes of the frame body, hashing each part as it starts */
+static void ax25_tx_body(ax25_tx_t *tx)
+{
+    const ax25_iovec_t *p = &tx->parts[tx->part];
+
+    tx->part_off += ax25_stuffer_feed(&tx->s, p->base + tx->part_off, p->len - tx->part_off);
+    if (tx->part_off < p->len)
+    {
+        return;
+    }
+
+    tx->part_off = 0;
+    if (++tx->part == tx->nparts)
+    {
+        /* The closing flag also opens the next frame, if there is one */
+        if (tx->source && tx->source(tx->source_user, tx) == AX25_ENC_OK)
+        {
+            tx->preamble_len = 0;
+            tx->state = AX25_TX_PREAMBLE;
+        }
+        else
+        {
+            tx->state = AX25_TX_POSTAMBLE;
+        }
+    }
+    else if (tx->part == tx->nparts - 1)
+    {
+        tx->fcs ^= 0xFFFF;
+        /* The MS bits are sent first ONLY at the FCS field */
+        tx->fcs_field[0] = (tx->fcs >> 8) & 0xFF;
+        tx->fcs_field[1] = tx->fcs & 0xFF;
+    }
+    else
+    {
+        tx->fcs = ax25_fcs_update(tx->fcs, tx->parts[tx->part].base, tx->parts[tx->part].len);
+    }
+}
+
+/**
+ * Produces the next chunk of the transmission: preamble flags, the opening
+ * flag, the bit stuffed frame, the closing flag and the postamble flags,
+ * packed MSB first. The last chunk is padded with 0's to a whole byte.
+ * @param tx the transmitter state
+ * @param buf receives the chunk
+ * @param n size of buf
+ * @return the number of bytes written to buf. Less than n only once the
+ * transmission is done
+ */
+size_t ax25_tx_next_chunk(ax25_tx_t *tx, uint8_t *buf, size_t n)
+{
+    ax25_stuffer_t *s = &tx->s;
+
+    s->out = buf;
+    s->out_cap = n;
+    s->out_idx = 0;
+    ax25_stuffer_drain(s);
+
+    while (s->out_idx < n && tx->state != AX25_TX_DONE)
+    {
+        switch (tx->state)
+        {
+        case AX25_TX_PREAMBLE:
+            /* the preamble is followed by the opening flag of the frame */
+            ax25_stuffer_put_flag(s);
+            if (++tx->flags_sent > tx->preamble_len)
+            {
+                tx->flags_sent = 0;
+                tx->state = AX25_TX_BODY;
+            }
+            break;
+        case AX25_TX_BODY:
+            ax25_tx_body(tx);
+            break;
+        case AX25_TX_POSTAMBLE:
+            /* the closing flag of the frame comes first */
+            ax25_stuffer_put_flag(s);
+            if (++tx->flags_sent > tx->postamble_len)
+            {
+                ax25_stuffer_push(s, 0, (8 - s->acc_bits % 8) % 8);
+                tx->state = AX25_TX_DONE;
+            }
+            break;
+        default:
+            break;
+        }
+    }
+    return s->out_idx;
+}
+
+#if AX25_FIXED_PREFIX
+/**
+ * Encodes a UI frame between the stations of config.h. The opening flag and
+ * header come pre-stuffed from ax25_fixed.h with the FCS register after
+ * them, so only the info field and the FCS are hashed and stuffed.
+ * @param out the output bitstream
+ * @param out_cap size of out. ax25_encoded_size_max() is always enough
+ * @param in the info field
+ * @param inlen length of in
+ * @return the number of bytes written to out, or -1
+ */
+int32_t ax25_encode_fixed(uint8_t *out, size_t out_cap, const uint8_t *in, size_t inlen)
+{
+    ax25_stuffer_t s;
+    uint8_t fcs_field[sizeof(uint16_t)];
+    uint16_t fcs;
+    size_t nbits;
+
+    if (inlen > AX25_MAX_FRAME_LEN || out_cap < AX25_FIXED_PREFIX_LEN)
+    {
+        return -1;
+    }
+    ax25_stuffer_init(&s, out, out_cap);
+    memcpy(out, ax25_fixed_prefix, AX25_FIXED_PREFIX_LEN);
+    s.out_idx = AX25_FIXED_PREFIX_LEN;
+    s.acc = AX25_FIXED_PREFIX_ACC;
+    s.acc_bits = AX25_FIXED_PREFIX_ACC_BITS;
+    s.cont_1 = AX25_FIXED_PREFIX_CONT_1;
+
+    fcs = ax25_fcs_update(AX25_FIXED_HDR_FCS, in, inlen) ^ 0xFFFF;
+    /* The MS bits are sent first ONLY at the FCS field */
+    fcs_field[0] = (fcs >> 8) & 0xFF;
+    fcs_field[1] = fcs & 0xFF;
+    if (ax25_stuffer_put(&s, in, inlen) != AX25_ENC_OK
+        || ax25_stuffer_put(&s, fcs_field, sizeof(fcs_field)) != AX25_ENC_OK
+        || ax25_stuffer_put_flag(&s) != AX25_ENC_OK
+        || ax25_stuffer_finish(&s, &nbits) != AX25_ENC_OK)
+    {
+        return -1;
+    }
+    return (int32_t)((nbits + 7) / 8);
+}
+#endif
+
+/**
+ * the main function to be called to create ax25 frames. Reentrant: the
+ * header is built from config.h on each call, callers sending many frames
+ * keep it in a context of their own with ax25_enc_init() and
+ * ax25_encode_into()
+ * @param out is the buffer to hold multiple ax.25 frames. It must fit
+ * ax25_encoded_size_max(inlen) bytes
+ * @param in data to be encoded
+ * @param len length of data to be encoded
+ * @param type ax25 frame type (I,S,U,UI frame)
+ */
+int32_t ax25_encode(uint8_t *out, const uint8_t *in, size_t inlen, ax25_frame_type_t type)
+{
+/**
+ * Future_parikshit_problems : the out buffer is 1d or 2d 
+*/
+    ax25_enc_ctx_t ctx;
+    int32_t ret_len;
+
+#if AX25_FIXED_PREFIX
+    if (type == AX25_UI_FRAME)
+    {
+        ret_len = ax25_encode_fixed(out, ax25_encoded_size_max(inlen), in, inlen);
+    }
+    else
+#endif
+    {
+        ax25_enc_init(&ctx, (const uint8_t *)GRD_CALLSIGN, GRD_SSID, (const uint8_t *)SAT_CALLSIGN, SAT_SSID);
+        ret_len = ax25_encode_into(&ctx, out, ax25_encoded_size_max(inlen), in, inlen, type);
+    }
+
+    AX25_LOG_DBG(AX25_LOG_EV_ENCODED, (uint32_t)ret_len, (uint32_t)type, 0);
+    return ret_len;
+}
+
+/**
+ * Advances the destuffing state machine by a single line bit
+ * @param cont_1 the run of 1's, updated
+ * @param bit the received bit
+ * @param event set to the flag/abort event the bit completes, if any
+ * @return 1 if the bit is a data bit, 0 if it was dropped
+ */
+static inline uint8_t ax25_deframer_step(uint8_t *cont_1, uint8_t bit, uint8_t *event)
+{
+    *event = AX25_DF_EV_NONE;
+    if (bit)
+    {
+        if (*cont_1 == AX25_DF_STATES - 1)
+        {
+            return 0;
+        }
+        (*cont_1)++;
+        if (*cont_1 == AX25_DF_STATES - 1)
+        {
+            *event = AX25_DF_EV_ABORT;
+        }
+        return *cont_1 <= 5;
+    }
+
+    switch (*cont_1)
+    {
+    case 5: /* stuffed zero */
+    case 7: /* end of an abort sequence */
+        *cont_1 = 0;
+        return 0;
+    case 6:
+        *cont_1 = 0;
+        *event = AX25_DF_EV_FLAG;
+        return 0;
+    default:
+        *cont_1 = 0;
+        return 1;
+    }
+}
+
+static void ax25_deframer_build_tables(void)
+{
+    uint8_t cont_1;
+    uint8_t event;
+    uint32_t data;
+    uint32_t ndata;
+    int state;
+    int b;
+    int j;
+
+    for (state = 0; state < AX25_DF_STATES; state++)
+    {
+        for (b = 0; b < 256; b++)
+        {
+            cont_1 = state;
+            data = ndata = 0;
+            event = AX25_DF_EV_NONE;
+            for (j = 0; j < 8 && event == AX25_DF_EV_NONE; j++)
+            {
+                if (ax25_deframer_step(&cont_1, (b >> (7 - j)) & 0x1, &event))
+                {
+                    data |= (uint32_t)((b >> (7 - j)) & 0x1) << ndata++;
+                }
+            }
+            ax25_deframer_table[state][b] = data | (ndata << 8) | ((uint32_t)cont_1 << 12) | ((uint32_t)event << 16) | ((uint32_t)j << 20);
+        }
+    }
+    ax25_deframer_table_ready = 1;
+}
+
+/**
+ * Prepares a deframer
+ * @param d the deframer state
+ * @param out buffer receiving the destuffed frame, including the FCS
+ * @param out_cap size of out. AX25_MAX_RAW_FRAME_LEN fits any valid frame
+ */
+void ax25_deframer_init(ax25_deframer_t *d, uint8_t *out, size_t out_cap)
+{
+    if (!ax25_deframer_table_ready)
+    {
+        ax25_deframer_build_tables();
+    }
+    memset(d, 0, sizeof(*d));
+    d->out = out;
+    d->out_cap = out_cap;
+}
+
+/* Appends destuffed bits to the frame under construction */
+static inline void ax25_deframer_data(ax25_deframer_t *d, uint8_t data, uint8_t ndata)
+{
+    uint8_t *out;
+
+    if (!d->in_frame)
+    {
+        return;
+    }
+    d->acc |= (uint16_t)data << d->acc_bits;
+    d->acc_bits += ndata;
+    if (d->acc_bits >= 8)
+    {
+        if (d->out_len == d->out_cap)
+        {
+            /* Oversized frame, hunt for the next flag */
+            AX25_STATS_INC(oversize);
+            AX25_LOG_WRN(AX25_LOG_EV_OVERSIZE, (uint32_t)d->out_cap, 0, 0);
+            d->in_frame = 0;
+            return;
+        }
+        d->out[d->out_len++] = (uint8_t)d->acc;
+        d->acc >>= 8;
+        d->acc_bits -= 8;
+
+        if (d->out_len == AX25_DF_HDR_LEN && d->on_hdr)
+        {
+            out = d->on_hdr(d->hdr_user, d->out);
+            if (!out)
+            {
+                d->in_frame = 0;
+                return;
+            }
+            d->out = out;
+        }
+
+        /* The last two bytes received may turn out to be the FCS */
+        if (d->out_len - d->fcs_len == AX25_DF_FCS_BLOCK + sizeof(uint16_t))
+        {
+            d->fcs = ax25_fcs_update(d->fcs, d->out + d->fcs_len, AX25_DF_FCS_BLOCK);
+            d->fcs_len += AX25_DF_FCS_BLOCK;
+        }
+    }
+}
+
+static inline void ax25_deframer_event(ax25_deframer_t *d, uint8_t event)
+{
+    if (event == AX25_DF_EV_ABORT)
+    {
+        if (d->in_frame && d->out_len)
+        {
+            AX25_STATS_INC(aborts);
+            AX25_LOG_DBG(AX25_LOG_EV_ABORT, (uint32_t)d->out_len, 0, 0);
+        }
+        d->in_frame = 0;
+        return;
+    }
+
+    /*
+     * The leading 0 and the five 1's of the closing flag have already
+     * been shifted in as data. A byte aligned frame leaves exactly those.
+     */
+    if (d->in_frame && d->acc_bits == 6 && d->out_len >= AX25_MIN_RAW_FRAME_LEN)
+    {
+        d->frame_ready = 1;
+        d->fcs = ax25_fcs_update(d->fcs, d->out + d->fcs_len, d->out_len - sizeof(uint16_t) - d->fcs_len) ^ 0xFFFF;
+        d->fcs_ok = d->fcs == ((((uint16_t)d->out[d->out_len - 2]) << 8) | d->out[d->out_len - 1]);
+        if (d->fcs_ok)
+        {
+            AX25_STATS_INC(frames);
+        }
+        else
+        {
+            AX25_STATS_INC(fcs_errors);
+            AX25_LOG_WRN(AX25_LOG_EV_FCS_ERROR, (uint32_t)(d->out_len - sizeof(uint16_t)), d->fcs,
+                         (uint32_t)d->out[d->out_len - 2] << 8 | d->out[d->out_len - 1]);
+        }
+    }
+    else
+    {
+        d->out_len = 0;
+    }
+    d->flag_seen = 1;
+    d->in_frame = 1;
+    d->acc = 0;
+    d->acc_bits = 0;
+    d->fcs = 0xFFFF;
+    d->fcs_len = 0;
+}
+
+/*
+ * Processes the nbits MS bits of b one at a time. If a frame completes,
+ * the bits left are kept for the next call.
+ */
+static void ax25_deframer_bits(ax25_deframer_t *d, uint8_t b, uint8_t nbits)
+{
+    uint8_t event;
+    uint8_t bit;
+
+    while (nbits--)
+    {
+        bit = b >> 7;
+        b <<= 1;
+        if (ax25_deframer_step(&d->cont_1, bit, &event))
+        {
+            ax25_deframer_data(d, bit, 1);
+        }
+        if (event != AX25_DF_EV_NONE)
+        {
+            ax25_deframer_event(d, event);
+            if (d->frame_ready)
+            {
+                d->rem = b;
+                d->rem_bits = nbits;
+                return;
+            }
+        }
+    }
+}
+
+/* Releases a frame returned by the previous call and flushes kept bits */
+static inline void ax25_deframer_resume(ax25_deframer_t *d)
+{
+    uint8_t nbits;
+
+    if (d->frame_ready)
+    {
+        d->frame_ready = 0;
+        d->out_len = 0;
+    }
+    if (d->rem_bits)
+    {
+        nbits = d->rem_bits;
+        d->rem_bits = 0;
+        ax25_deframer_bits(d, d->rem, nbits);
+    }
+}
+
+/* Body of ax25_deframer_push() */
+static size_t ax25_deframer_run(ax25_deframer_t *d, const uint8_t *in, size_t len)
+{
+    uint32_t e;
+    uint8_t b;
+    size_t i;
+    size_t j;
+    size_t scan_at = 0;
+
+    ax25_deframer_resume(d);
+    if (d->frame_ready)
+    {
+        return 0;
+    }
+
+    for (i = 0; i < len; i++)
+    {
+        /*
+         * While hunting, jump over the bytes that cannot hold a flag. The
+         * pending run of 1's is handed to the scanner as the byte before
+         * in[i]. After a candidate, a few bytes go through the tables before
+         * scanning again, noise holds a candidate every few bytes.
+         */
+        if (!d->in_frame && i >= scan_at && d->line == AX25_LINE_NONE)
+        {
+            AX25_PROF_START(t0);
+            j = i + ax25_flag_scan(in + i, len - i, (uint8_t)((1U << d->cont_1) - 1));
+            AX25_PROF_END(AX25_PROF_FLAG_SCAN, t0);
+            if (j > i)
+            {
+                b = in[j - 1];
+                for (d->cont_1 = 0; b & 0x1; b >>= 1)
+                {
+                    d->cont_1++;
+                }
+                i = j;
+                if (i == len)
+                {
+                    break;
+                }
+            }
+            scan_at = i + AX25_DF_SCAN_GAP;
+        }
+
+        b = in[i];
+        if (d->line & AX25_LINE_G3RUH)
+        {
+            b = ax25_g3ruh_descramble(&d->lfsr, b);
+        }
+        if (d->line & AX25_LINE_NRZI)
+        {
+            b = ax25_nrzi_decode(&d->nrzi_level, b);
+        }
+        e = ax25_deframer_table[d->cont_1][b];
+        ax25_deframer_data(d, AX25_DF_DATA(e), AX25_DF_NDATA(e));
+        d->cont_1 = AX25_DF_CONT1(e);
+        if (AX25_DF_EVENT(e) == AX25_DF_EV_NONE)
+        {
+            continue;
+        }
+
+        ax25_deframer_event(d, AX25_DF_EVENT(e));
+        if (d->frame_ready)
+        {
+            d->rem = b << AX25_DF_USED(e);
+            d->rem_bits = 8 - AX25_DF_USED(e);
+            return i + 1;
+        }
+        ax25_deframer_bits(d, b << AX25_DF_USED(e), 8 - AX25_DF_USED(e));
+        if (d->frame_ready)
+        {
+            return i + 1;
+        }
+    }
+    return len;
+}
+
+/**
+ * Feeds a packed bitstream (MS bit received first) to the deframer. The
+ * input is descrambled and NRZI decoded according to d->line, then
+ * consumed a byte at a time through the transition tables and
+ * processing stops as soon as a frame is complete. The frame stays in
+ * d->out, d->out_len bytes long including the FCS, until the next call.
+ * @param d the deframer state
+ * @param in received bytes
+ * @param len number of bytes in ax25_frame
+ * @return the number of input bytes consumed
+ */
+size_t ax25_deframer_push(ax25_deframer_t *d, const uint8_t *in, size_t len)
+{
+    AX25_PROF_START(t0);
+    size_t n = ax25_deframer_run(d, in, len);
+
+    AX25_PROF_END(AX25_PROF_DESTUFF, t0);
+    return n;
+}
+
+/* Reports the outcome of a one-shot decode */
+static ax25_decode_status_t ax25_deframer_status(const ax25_deframer_t *d, size_t *out_len)
+{
+    if (!d->flag_seen)
+    {
+        AX25_STATS_INC(no_flag);
+        AX25_LOG_INF(AX25_LOG_EV_NO_FLAG, 0, 0, 0);
+        return AX25_DEC_FAIL;
+    }
+    if (!d->frame_ready)
+    {
+        AX25_STATS_INC(truncated);
+        AX25_LOG_INF(AX25_LOG_EV_TRUNCATED, (uint32_t)d->out_len, 0, 0);
+        return AX25_DEC_FAIL;
+    }
+    if (!d->fcs_ok)
+    {
+        return AX25_DEC_FAIL;
+    }
+    *out_len = d->out_len - sizeof(uint16_t);
+    return AX25_DEC_OK;
+}
+
+/*
+ * Syndromes of single bit errors. The FCS is linear: flipping a data bit
+ * XORs the received FCS check with a value that only depends on how many
+ * bits follow it. Entry n is that value for a bit followed by n data bits.
+ */
+static uint16_t ax25_fcs_syndrome[(AX25_MAX_RAW_FRAME_LEN - sizeof(uint16_t)) * 8];
+static uint8_t ax25_fcs_syndrome_ready = 0;
+
+static void ax25_fcs_build_syndromes(void)
+{
+    uint16_t s = 0x8408;
+    size_t n;
+
+    for (n = 0; n < sizeof(ax25_fcs_syndrome) / sizeof(ax25_fcs_syndrome[0]); n++)
+    {
+        ax25_fcs_syndrome[n] = s;
+        s = (s & 0x1) ? (s >> 1) ^ 0x8408 : s >> 1;
+    }
+    ax25_fcs_syndrome_ready = 1;
+}
+
+/*
+ * Syndrome of bit p of a frame of len bytes, FCS included. Bits are
+ * numbered 8 * byte + bit, LS bit first, like they are sent.
+ */
+static inline uint16_t ax25_fcs_bit_syndrome(size_t len, size_t p)
+{
+    size_t data_bits = (len - sizeof(uint16_t)) * 8;
+
+    if (p < data_bits)
+    {
+        return ax25_fcs_syndrome[data_bits - 1 - p];
+    }
+    /* The FCS field is compared high byte first */
+    return (p - data_bits < 8) ? (uint16_t)(0x100 << (p - data_bits)) : (uint16_t)(1 << (p - data_bits - 8));
+}
+
+/* Finds the up to n least reliable bits of the frame, most reliable last */
+static size_t ax25_fcs_least_reliable(size_t *pos, size_t n, const uint8_t *conf, size_t nbits)
+{
+    size_t found = 0;
+    size_t p;
+    size_t k;
+
+    for (p = 0; p < nbits; p++)
+    {
+        if (found == n && conf[p] >= conf[pos[n - 1]])
+        {
+            continue;
+        }
+        k = (found < n) ? found++ : n - 1;
+        for (; k > 0 && conf[pos[k - 1]] > conf[p]; k--)
+        {
+            pos[k] = pos[k - 1];
+        }
+        pos[k] = p;
+    }
+    return found;
+}
+
+/**
+ * Tries to repair a frame whose FCS does not match by flipping bits. With
+ * confidences, every combination of the cfg->max_flips least reliable bits
+ * is tested in Gray code order: each pattern costs a single XOR of
+ * precomputed syndromes, and the matching pattern with the lowest total
+ * confidence wins. cfg->single_bit then tries every bit alone. Errors that
+ * broke the bit stuffing change the frame length and cannot be repaired.
+ * @param frame the destuffed frame, FCS included. Repaired in place
+ * @param len length of frame
+ * @param conf confidence of each bit, numbered like ax25_fcs_bit_syndrome(),
+ * higher is more reliable. NULL if unknown
+ * @param cfg recovery settings
+ * @return the number of bits flipped, 0 if the FCS was right, or -1
+ */
+int ax25_fcs_recover(uint8_t *frame, size_t len, const uint8_t *conf, const ax25_recover_cfg_t *cfg)
+{
+    size_t pos[AX25_RECOVER_MAX_FLIPS];
+    size_t nbits = len * 8;
+    size_t n = 0;
+    size_t p;
+    uint32_t tried = 0;
+    uint32_t g;
+    uint32_t best = 0;
+    uint32_t cost = 0;
+    uint32_t best_cost = UINT32_MAX;
+    uint16_t syn[AX25_RECOVER_MAX_FLIPS];
+    uint16_t target;
+    uint16_t acc = 0;
+    int flips = 0;
+
+    if (len < AX25_MIN_RAW_FRAME_LEN || len > AX25_MAX_RAW_FRAME_LEN)
+    {
+        return -1;
+    }
+    target = ax25_fcs(frame, len - sizeof(uint16_t)) ^ ((((uint16_t)frame[len - 2]) << 8) | frame[len - 1]);
+    if (target == 0)
+    {
+        return 0;
+    }
+    if (!ax25_fcs_syndrome_ready)
+    {
+        ax25_fcs_build_syndromes();
+    }
+
+    if (conf && cfg->max_flips)
+    {
+        n = ax25_fcs_least_reliable(pos, cfg->max_flips < AX25_RECOVER_MAX_FLIPS ? cfg->max_flips : AX25_RECOVER_MAX_FLIPS, conf, nbits);
+        for (p = 0; p < n; p++)
+        {
+            syn[p] = ax25_fcs_bit_syndrome(len, pos[p]);
+        }
+        /* Pattern g ^ (g >> 1) differs from the previous one in bit ctz(g) */
+        for (g = 1; g < (1UL << n) && tried < cfg->budget; g++, tried++)
+        {
+            p = __builtin_ctz(g);
+            acc ^= syn[p];
+            cost = ((g ^ (g >> 1)) >> p & 0x1) ? cost + conf[pos[p]] : cost - conf[pos[p]];
+            if (acc == target && cost < best_cost)
+            {
+                best = g ^ (g >> 1);
+                best_cost = cost;
+            }
+        }
+        if (best)
+        {
+            for (p = 0; p < n; p++)
+            {
+                if (best >> p & 0x1)
+                {
+                    frame[pos[p] / 8] ^= 1 << (pos[p] % 8);
+                    flips++;
+                }
+            }
+            return flips;
+        }
+    }
+
+    if (cfg->single_bit)
+    {
+        for (p = 0; p < nbits && tried < cfg->budget; p++, tried++)
+        {
+            if (ax25_fcs_bit_syndrome(len, p) == target)
+            {
+                frame[p / 8] ^= 1 << (p % 8);
+                return 1;
+            }
+        }
+    }
+    return -1;
+}
+
+/**
+ * Repeats a frame as the next digipeater of its path: sets the H bit of
+ * our address and patches the FCS in place. The FCS is linear, so the
+ * flipped bit changes it by its precomputed syndrome and the frame is not
+ * hashed again once its received FCS is checked. Send it with
+ * ax25_encode_raw().
+ * @param frame the destuffed frame, FCS included
+ * @param len length of frame, at most AX25_MAX_RAW_FRAME_LEN
+ * @param call our callsign
+ * @param ssid our SSID
+ * @return AX25_DEC_OK if the frame is to be repeated, else AX25_DEC_FAIL,
+ * also for a bad FCS, which is never patched into a valid one
+ */
+ax25_decode_status_t ax25_digipeat(uint8_t *frame, size_t len, const uint8_t *call, uint8_t ssid)
+{
+    ax25_addr_path_t path;
+    size_t h_byte;
+    uint16_t syn;
+
+    if (len < AX25_MIN_RAW_FRAME_LEN || len > AX25_MAX_RAW_FRAME_LEN
+        || ax25_parse_addr(frame, len - sizeof(uint16_t), &path) != AX25_DEC_OK
+        || path.next_digi == path.ndigis || !ax25_addr_match(path.digi[path.next_digi], call, ssid))
+    {
+        return AX25_DEC_FAIL;
+    }
+    if (ax25_fcs(frame, len - sizeof(uint16_t)) != ((((uint16_t)frame[len - 2]) << 8) | frame[len - 1]))
+    {
+        return AX25_DEC_FAIL;
+    }
+    if (!ax25_fcs_syndrome_ready)
+    {
+        ax25_fcs_build_syndromes();
+    }
+    h_byte = path.digi[path.next_digi] + 6 - frame;
+    frame[h_byte] |= AX25_ADDR_H_BIT;
+    syn = ax25_fcs_bit_syndrome(len, h_byte * 8 + 7);
+    frame[len - 2] ^= (uint8_t)(syn >> 8);
+    frame[len - 1] ^= (uint8_t)(syn & 0xFF);
+    return AX25_DEC_OK;
+}
+
+/**
+ * Decodes the first frame of a one bit per byte stream
+ * @param out holds the decoded frame. Must fit AX25_MAX_RAW_FRAME_LEN bytes
+ * @param out_len the length of the decoded frame, without the FCS
+ * @param ax25_frame the received bits, one per byte
+ * @param len number of bits
+ */
+ax25_decode_status_t ax25_decode(uint8_t *out, size_t *out_len, const uint8_t *ax25_frame, size_t len)
+{
+    ax25_deframer_t d;
+    uint8_t b = 0;
+    size_t i;
+
+    ax25_deframer_init(&d, out, AX25_MAX_RAW_FRAME_LEN);
+    for (i = 0; i < len && !d.frame_ready; i++)
+    {
+        b = (b << 1) | (ax25_frame[i] & 0x1);
+        if (i % 8 == 7)
+        {
+            ax25_deframer_push(&d, &b, 1);
+        }
+    }
+    if (!d.frame_ready && len % 8)
+    {
+        ax25_deframer_bits(&d, b << (8 - len % 8), len % 8);
+    }
+    return ax25_deframer_status(&d, out_len);
+}
+
+/**
+ * Decodes the first frame of a soft decision stream and tries to repair it
+ * if its FCS does not match
+ * @param out holds the decoded frame. Must fit AX25_MAX_RAW_FRAME_LEN bytes
+ * @param out_len the length of the decoded frame, without the FCS
+ * @param soft one value per received bit: the sign is the bit, 1 if
+ * positive, the magnitude its confidence
+ * @param len number of bits
+ * @param cfg recovery settings, or NULL to only decode
+ */
+ax25_decode_status_t ax25_decode_soft(uint8_t *out, size_t *out_len, const int8_t *soft, size_t len, const ax25_recover_cfg_t *cfg)
+{
+    ax25_deframer_t d;
+    uint8_t conf[AX25_MAX_RAW_FRAME_LEN * 8];
+    uint8_t event;
+    uint8_t bit;
+    size_t i;
+
+    ax25_deframer_init(&d, out, AX25_MAX_RAW_FRAME_LEN);
+    for (i = 0; i < len && !d.frame_ready; i++)
+    {
+        bit = soft[i] > 0;
+        if (ax25_deframer_step(&d.cont_1, bit, &event))
+        {
+            if (d.in_frame && d.out_len < d.out_cap)
+            {
+                conf[d.out_len * 8 + d.acc_bits] = soft[i] < 0 ? -soft[i] : soft[i];
+            }
+            ax25_deframer_data(&d, bit, 1);
+        }
+        if (event != AX25_DF_EV_NONE)
+        {
+            ax25_deframer_event(&d, event);
+        }
+    }
+    if (d.frame_ready && !d.fcs_ok && cfg && ax25_fcs_recover(d.out, d.out_len, conf, cfg) > 0)
+    {
+        d.fcs_ok = 1;
+    }
+    return ax25_deframer_status(&d, out_len);
+}
+
+/**
+ * Decodes the first frame of a packed bitstream
+ * @param out holds the decoded frame. Must fit AX25_MAX_RAW_FRAME_LEN bytes
+ * @param in received bytes, MS bit first
+ * @param len number of bytes in in
+ * @return the length of the decoded frame without the FCS, or -1
+ */
+uint32_t ax25_recv(uint8_t *out, const uint8_t *in, size_t len)
+{
+    ax25_deframer_t d;
+    size_t decode_len;
+
+    ax25_deframer_init(&d, out, AX25_MAX_RAW_FRAME_LEN);
+    ax25_deframer_push(&d, in, len);
+    if (ax25_deframer_status(&d, &decode_len) != AX25_DEC_OK)
+    {
+        return -1;
+    }
+    return (uint32_t)decode_len;
+}
+
+/**
+ * Prepares a streaming receiver
+ * @param ctx the receiver context
+ * @param on_frame called for every frame with a valid FCS
+ * @param user opaque pointer passed to on_frame
+ */
+void ax25_rx_init(ax25_rx_ctx_t *ctx, ax25_rx_frame_cb_t on_frame, void *user)
+{
+    ax25_deframer_init(&ctx->deframer, ctx->frame, sizeof(ctx->frame));
+    ctx->recover = NULL;
+    ctx->on_frame = on_frame;
+    ctx->user = user;
+}
+
+/**
+ * Drops any partially received frame and waits for a new flag
+ * @param ctx the receiver context
+ */
+void ax25_rx_reset(ax25_rx_ctx_t *ctx)
+{
+    uint8_t line = ctx->deframer.line;
+
+    ax25_deframer_init(&ctx->deframer, ctx->frame, sizeof(ctx->frame));
+    ctx->deframer.line = line;
+}
+
+/**
+ * Selects the line decoding applied in front of the deframer. It must
+ * match the line coding of the transmitter.
+ * @param ctx the receiver context
+ * @param line AX25_LINE_NONE or a combination of AX25_LINE_NRZI and
+ * AX25_LINE_G3RUH
+ */
+void ax25_rx_set_line_coding(ax25_rx_ctx_t *ctx, uint8_t line)
+{
+    ctx->deframer.line = line;
+}
+
+/**
+ * Enables the repair of frames received with a bad FCS. Hard decisions
+ * carry no confidences, so only cfg->single_bit applies. Call it before
+ * the receiver is used from another thread.
+ * @param ctx the receiver context
+ * @param cfg recovery settings, kept by reference, or NULL to disable
+ */
+void ax25_rx_set_recovery(ax25_rx_ctx_t *ctx, const ax25_recover_cfg_t *cfg)
+{
+    /* Build the syndromes now, receivers may run on several threads */
+    if (cfg && !ax25_fcs_syndrome_ready)
+    {
+        ax25_fcs_build_syndromes();
+    }
+    ctx->recover = cfg;
+}
+
+/**
+ * Feeds the next chunk of a packed bitstream to the receiver. Chunks do not
+ * need to be aligned to frames; a frame may span any number of calls.
+ * Every complete frame with a valid FCS is passed to the frame callback
+ * before this call returns, without the FCS.
+ * @param ctx the receiver context
+ * @param in received bytes, MS bit first
+ * @param len number of bytes in in
+ */
+void ax25_rx_push(ax25_rx_ctx_t *ctx, const uint8_t *in, size_t len)
+{
+    ax25_deframer_t *d = &ctx->deframer;
+    size_t n;
+
+    do
+    {
+        n = ax25_deframer_push(d, in, len);
+        in += n;
+        len -= n;
+        if (d->frame_ready && !d->fcs_ok && ctx->recover && ax25_fcs_recover(d->out, d->out_len, NULL, ctx->recover) > 0)
+        {
+            d->fcs_ok = 1;
+        }
+        if (d->frame_ready && d->fcs_ok && ctx->on_frame)
+        {
+            ctx->on_frame(ctx->user, d->out, d->out_len - sizeof(uint16_t));
+        }
+    } while (len || d->frame_ready);
+}
+
+/**
+ * Extracts every frame of a packed bitstream in a single pass. A closing
+ * flag may also open the next frame. Frames are destuffed straight into
+ * the arena, one after the other, each followed by its two FCS bytes.
+ * Decoding stops early if descs or the arena are exhausted; it can be
+ * resumed from the byte before the in_offset of the last descriptor.
+ * @param descs receives one descriptor per frame, bad FCS included
+ * @param max_descs number of entries in descs
+ * @param arena holds the decoded frames
+ * @param arena_cap size of the arena in bytes
+ * @param in received bytes, MS bit first
+ * @param len number of bytes in in
+ * @return the number of descriptors filled
+ */
+size_t ax25_decode_batch(ax25_frame_desc_t *descs, size_t max_descs, uint8_t *arena, size_t arena_cap, const uint8_t *in, size_t len)
+{
+    ax25_deframer_t d;
+    size_t used = 0;
+    size_t ndescs = 0;
+    size_t pos = 0;
+
+    if (arena_cap < AX25_MAX_RAW_FRAME_LEN)
+    {
+        return 0;
+    }
+    ax25_deframer_init(&d, arena, AX25_MAX_RAW_FRAME_LEN);
+    while (ndescs < max_descs)
+    {
+        pos += ax25_deframer_push(&d, in + pos, len - pos);
+        if (!d.frame_ready)
+        {
+            break;
+        }
+
+        descs[ndescs].offset = used;
+        descs[ndescs].len = d.out_len - sizeof(uint16_t);
+        descs[ndescs].in_offset = pos - 1;
+        descs[ndescs].status = d.fcs_ok ? AX25_DEC_OK : AX25_DEC_FAIL;
+        ndescs++;
+
+        used += d.out_len;
+        if (arena_cap - used < AX25_MAX_RAW_FRAME_LEN)
+        {
+            break;
+        }
+        d.out = arena + used;
+    }
+    return ndescs;
+}
+
+ax25_prof_t ax25_prof;
+
+/**
+ * Starts the cycle counter. On Cortex-M the DWT is enabled here, elsewhere
+ * the counter always runs. Clears the counters and timings.
+ */
+void ax25_prof_init(void)
+{
+#if defined(__ARM_ARCH_7M__) || defined(__ARM_ARCH_7EM__) || defined(__ARM_ARCH_8M_MAIN__)
+    *(volatile uint32_t *)0xE000EDFC |= 1UL << 24; /* DEMCR.TRCENA */
+    *(volatile uint32_t *)0xE0001004 = 0;         /* DWT_CYCCNT */
+    *(volatile uint32_t *)0xE0001000 |= 1UL;      /* DWT_CTRL.CYCCNTENA */
+#endif
+    ax25_prof_reset();
+}
+
+/**
+ * Clears the counters and timings
+ */
+void ax25_prof_reset(void)
+{
+    memset(&ax25_prof, 0, sizeof(ax25_prof));
+}
+
+/**
+ * Records a timed run of a stage in its totals and in the ring of recent
+ * samples. Called by AX25_PROF_END().
+ * @param stage the stage
+ * @param cycles cycle count of the run
+ */
+void ax25_prof_record(ax25_prof_stage_t stage, uint32_t cycles)
+{
+#if AX25_PROF
+    ax25_prof_sample_t *sample;
+    uint32_t max;
+
+    /* Each run gets its own ring entry, even from concurrent receivers */
+    sample = &ax25_prof.ring[__atomic_fetch_add(&ax25_prof.ring_next, 1, __ATOMIC_RELAXED) % AX25_PROF_RING_LEN];
+    AX25_PROF_ADD(stages[stage].count, 1);
+    AX25_PROF_ADD(stages[stage].total, cycles);
+    max = AX25_PROF_LOAD(stages[stage].max);
+    while (cycles > max)
+    {
+        /* On failure max is reloaded with the value stored by another run */
+        if (__atomic_compare_exchange_n(&ax25_prof.stages[stage].max, &max, cycles, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        {
+            break;
+        }
+    }
+    __atomic_store_n(&sample->stage, (uint8_t)stage, __ATOMIC_RELAXED);
+    __atomic_store_n(&sample->cycles, cycles, __ATOMIC_RELAXED);
+#else
+    (void)stage;
+    (void)cycles;
+#endif
+}
+
+static uint8_t *ax25_prof_put(uint8_t *out, uint64_t v, size_t n)
+{
+    size_t i;
+
+    for (i = 0; i < n; i++)
+    {
+        *out++ = (uint8_t)(v >> (8 * i));
+    }
+    return out;
+}
+
+/**
+ * Serializes the counters and timings for telemetry, little endian: the six
+ * counters as u32, then with AX25_PROF the count (u32), max (u32) and total
+ * (u64) of each stage, the number of samples recorded (u32) and the ring of
+ * samples as stage (u8) and cycles (u32), oldest first
+ * @param out the output buffer
+ * @param out_cap size of out, at least AX25_PROF_DUMP_LEN
+ * @return the number of bytes written, or 0 if out is too small
+ */
+size_t ax25_prof_dump(uint8_t *out, size_t out_cap)
+{
+    uint8_t *p = out;
+#if AX25_PROF
+    const ax25_prof_sample_t *sample;
+    uint32_t next;
+    size_t i;
+#endif
+
+    if (out_cap < AX25_PROF_DUMP_LEN)
+    {
+        return 0;
+    }
+    p = ax25_prof_put(p, AX25_PROF_LOAD(frames), 4);
+    p = ax25_prof_put(p, AX25_PROF_LOAD(fcs_errors), 4);
+    p = ax25_prof_put(p, AX25_PROF_LOAD(aborts), 4);
+    p = ax25_prof_put(p, AX25_PROF_LOAD(oversize), 4);
+    p = ax25_prof_put(p, AX25_PROF_LOAD(no_flag), 4);
+    p = ax25_prof_put(p, AX25_PROF_LOAD(truncated), 4);
+#if AX25_PROF
+    for (i = 0; i < AX25_PROF_NSTAGES; i++)
+    {
+        p = ax25_prof_put(p, AX25_PROF_LOAD(stages[i].count), 4);
+        p = ax25_prof_put(p, AX25_PROF_LOAD(stages[i].max), 4);
+        p = ax25_prof_put(p, AX25_PROF_LOAD(stages[i].total), 8);
+    }
+    next = AX25_PROF_LOAD(ring_next);
+    p = ax25_prof_put(p, next, 4);
+    for (i = 0; i < AX25_PROF_RING_LEN; i++)
+    {
+        sample = &ax25_prof.ring[(next + i) % AX25_PROF_RING_LEN];
+        p = ax25_prof_put(p, __atomic_load_n(&sample->stage, __ATOMIC_RELAXED), 1);
+        p = ax25_prof_put(p, __atomic_load_n(&sample->cycles, __ATOMIC_RELAXED), 4);
+    }
+#endif
+    return (size_t)(p - out);
+}
@@ -0,0 +1,136 @@
+#include "ax25_beacon.h"
+
+static void ax25_beacon_save(const ax25_stuffer_t *s, ax25_beacon_cp_t *cp)
+{
+    cp->out_idx = (uint16_t)s->out_idx;
+    cp->acc = (uint8_t)s->acc;
+    cp->acc_bits = s->acc_bits;
+    cp->cont_1 = s->cont_1;
+    cp->nrzi_level = s->coder.nrzi_level;
+    cp->lfsr = s->coder.lfsr;
+}
+
+static void ax25_beacon_restore(ax25_beacon_template_t *b, ax25_stuffer_t *s, const ax25_beacon_cp_t *cp)
+{
+    ax25_stuffer_init(s, b->bits, sizeof(b->bits));
+    s->coder.line = b->ctx.line;
+    s->out_idx = cp->out_idx;
+    s->acc = cp->acc;
+    s->acc_bits = cp->acc_bits;
+    s->cont_1 = cp->cont_1;
+    s->coder.nrzi_level = cp->nrzi_level;
+    s->coder.lfsr = cp->lfsr;
+}
+
+/*
+ * Stuffs the info field from byte from on, a multiple of
+ * AX25_BEACON_CP_STEP, recording the checkpoints, then the FCS and the
+ * closing flag
+ * @return the length of the encoded frame, or -1
+ */
+static int32_t ax25_beacon_stuff(ax25_beacon_template_t *b, ax25_stuffer_t *s, size_t from)
+{
+    uint8_t fcs_field[sizeof(uint16_t)];
+    uint16_t fcs = b->fcs ^ 0xFFFF;
+    size_t nbits;
+    size_t n;
+    size_t i;
+
+    for (i = from; i < b->len; i += n)
+    {
+        n = b->len - i < AX25_BEACON_CP_STEP ? b->len - i : AX25_BEACON_CP_STEP;
+        ax25_beacon_save(s, &b->cp[i / AX25_BEACON_CP_STEP]);
+        if (ax25_stuffer_put(s, &b->info[i], n) != AX25_ENC_OK)
+        {
+            return -1;
+        }
+    }
+
+    /* The MS bits are sent first ONLY at the FCS field */
+    fcs_field[0] = (fcs >> 8) & 0xFF;
+    fcs_field[1] = fcs & 0xFF;
+    if (ax25_stuffer_put(s, fcs_field, sizeof(fcs_field)) != AX25_ENC_OK
+        || ax25_stuffer_put_flag(s) != AX25_ENC_OK
+        || ax25_stuffer_finish(s, &nbits) != AX25_ENC_OK)
+    {
+        return -1;
+    }
+    b->bits_len = (nbits + 7) / 8;
+    return (int32_t)b->bits_len;
+}
+
+/**
+ * Encodes the first frame of a beacon. The bitstream is left in b->bits.
+ * @param b the template
+ * @param ctx the encoder context, copied
+ * @param info the info field
+ * @param len length of info. Every later frame has this length
+ * @return the length of the encoded frame, or -1
+ */
+int32_t ax25_beacon_init(ax25_beacon_template_t *b, const ax25_enc_ctx_t *ctx, const uint8_t *info, size_t len)
+{
+    /* as there is no layer 3 being used PID is set to 0xF0 */
+    const uint8_t hdr[] = { AX25_CTRL_UI, 0xF0 };
+    ax25_stuffer_t s;
+
+    if (len > AX25_MAX_FRAME_LEN)
+    {
+        return -1;
+    }
+    b->ctx = *ctx;
+    memcpy(b->info, info, len);
+    b->len = len;
+    b->fcs = ax25_fcs_update(ax25_fcs_update(ctx->addr_fcs, hdr, sizeof(hdr)), info, len);
+
+    ax25_stuffer_init(&s, b->bits, sizeof(b->bits));
+    if (ax25_stuffer_open(&s, ctx->line) != AX25_ENC_OK
+        || ax25_stuffer_put(&s, ctx->addr, ctx->addr_len) != AX25_ENC_OK
+        || ax25_stuffer_put(&s, hdr, sizeof(hdr)) != AX25_ENC_OK)
+    {
+        return -1;
+    }
+    return ax25_beacon_stuff(b, &s, 0);
+}
+
+/**
+ * Encodes the next frame of a beacon. Each run of changed bytes updates
+ * the FCS by its own contribution, advanced over the bytes after it, and
+ * stuffing resumes from the checkpoint before the first changed byte.
+ * @param b the template
+ * @param info the new info field, of the length given to ax25_beacon_init()
+ * @return the length of the encoded frame in b->bits, or -1
+ */
+int32_t ax25_beacon_update(ax25_beacon_template_t *b, const uint8_t *info)
+{
+    uint8_t delta[AX25_MAX_FRAME_LEN];
+    ax25_stuffer_t s;
+    size_t first = b->len;
+    size_t start;
+    size_t i = 0;
+
+    while (i < b->len)
+    {
+        if (info[i] == b->info[i])
+        {
+            i++;
+            continue;
+        }
+        for (start = i; i < b->len && info[i] != b->info[i]; i++)
+        {
+            delta[i] = info[i] ^ b->info[i];
+        }
+        b->fcs ^= ax25_fcs_shift(ax25_fcs_update(0, delta + start, i - start), b->len - i);
+        memcpy(b->info + start, info + start, i - start);
+        if (first == b->len)
+        {
+            first = start;
+        }
+    }
+    if (first == b->len)
+    {
+        return (int32_t)b->bits_len;
+    }
+    first -= first % AX25_BEACON_CP_STEP;
+    ax25_beacon_restore(b, &s, &b->cp[first / AX25_BEACON_CP_STEP]);
+    return ax25_beacon_stuff(b, &s, first);
+}
@@ -0,0 +1,639 @@
+#include "ax25_conn.h"
+
+/* Bit of the SSID bytes telling commands from responses */
+#define AX25_CONN_C_BIT 0x80
+
+/* Wrap-safe comparison of ms timestamps */
+#define AX25_CONN_DUE(now, t) ((int32_t)((now) - (t)) >= 0)
+
+/* Sequence number arithmetic, modulo c->modulus */
+static inline uint8_t ax25_conn_seq(const ax25_conn_t *c, uint32_t n)
+{
+    return (uint8_t)(n & (c->modulus - 1));
+}
+
+static inline uint8_t ax25_conn_outstanding(const ax25_conn_t *c)
+{
+    return ax25_conn_seq(c, (uint32_t)c->vs - c->va + c->modulus);
+}
+
+static inline ax25_conn_slot_t *ax25_conn_slot(ax25_conn_t *c, uint8_t ns)
+{
+    return &c->slots[ns % AX25_CONN_MAX_WINDOW];
+}
+
+/* Sets the C bits of an address field and hashes it again */
+static void ax25_conn_set_c_bits(ax25_enc_ctx_t *ctx, uint8_t command)
+{
+    ctx->addr[6] = (ctx->addr[6] & ~AX25_CONN_C_BIT) | (command ? AX25_CONN_C_BIT : 0);
+    ctx->addr[13] = (ctx->addr[13] & ~AX25_CONN_C_BIT) | (command ? 0 : AX25_CONN_C_BIT);
+    ctx->addr_fcs = ax25_fcs_update(0xFFFF, ctx->addr, ctx->addr_len);
+}
+
+static void ax25_conn_start_t1(ax25_conn_t *c, uint32_t now)
+{
+    c->t1_running = 1;
+    c->t1_expiry = now + c->t1;
+}
+
+/*
+ * Line codes a stuffed frame and hands it to the send callback. Every frame
+ * goes through the coder of the link, after the flags a receiver needs to
+ * lock on.
+ */
+static void ax25_conn_transmit(ax25_conn_t *c, const uint8_t *bits, size_t len)
+{
+    size_t sync = AX25_LINE_SYNC_FLAGS(c->coder.line);
+
+    memset(c->tx, AX25_FLAG, sync);
+    ax25_line_code(&c->coder, c->tx, c->tx, sync);
+    ax25_line_code(&c->coder, c->tx + sync, bits, len);
+    c->send(c->user, c->tx, sync + len);
+}
+
+/* Encodes a frame and hands it to the send callback */
+static void ax25_conn_emit(ax25_conn_t *c, uint8_t command, uint16_t ctrl, size_t ctrl_len, const uint8_t *info, size_t len)
+{
+    ax25_iovec_t iov = { info, len };
+    int32_t ret_len;
+
+    ret_len = ax25_encode_ctrl_iov(command ? &c->cmd : &c->rsp, c->buf, sizeof(c->buf), ctrl, ctrl_len, &iov, info ? 1 : 0);
+    if (ret_len > 0)
+    {
+        ax25_conn_transmit(c, c->buf, (size_t)ret_len);
+    }
+}
+
+static void ax25_conn_send_u(ax25_conn_t *c, uint8_t command, uint8_t code, uint8_t pf)
+{
+    size_t ctrl_len;
+    uint16_t ctrl = ax25_ctrl_u(code, pf, &ctrl_len);
+
+    ax25_conn_emit(c, command, ctrl, ctrl_len, NULL, 0);
+}
+
+static void ax25_conn_send_s(ax25_conn_t *c, uint8_t command, uint8_t code, uint8_t pf)
+{
+    size_t ctrl_len;
+    uint16_t ctrl = ax25_ctrl_s(code, c->vr, pf, c->cfg.mod128, &ctrl_len);
+
+    ax25_conn_emit(c, command, ctrl, ctrl_len, NULL, 0);
+    /* Every S frame carries N(R), so it acknowledges all we received */
+    c->ack_pending = 0;
+    c->t2_running = 0;
+}
+
+/*
+ * Brings the N(R) of a retained I frame up to date. The info field is
+ * recovered from the bitstream itself, so the pool holds no other copy.
+ * @return 0, or -1 if the slot does not hold a valid frame
+ */
+static int ax25_conn_rebuild(ax25_conn_t *c, ax25_conn_slot_t *slot, uint8_t ns)
+{
+    ax25_deframer_t d;
+    ax25_ctrl_info_t fi;
+    ax25_iovec_t iov;
+    size_t ctrl_len;
+    uint16_t ctrl;
+    int32_t ret_len;
+
+    ax25_deframer_init(&d, c->frame, sizeof(c->frame));
+    ax25_deframer_push(&d, slot->bits, slot->len);
+    if (!d.frame_ready || !d.fcs_ok || ax25_parse_ctrl(c->frame, d.out_len - sizeof(uint16_t), c->cfg.mod128, &fi) != AX25_DEC_OK)
+    {
+        return -1;
+    }
+    iov.base = c->frame + fi.info_off;
+    iov.len = d.out_len - sizeof(uint16_t) - fi.info_off;
+    ctrl = ax25_ctrl_i(ns, c->vr, 0, c->cfg.mod128, &ctrl_len);
+    ret_len = ax25_encode_ctrl_iov(&c->cmd, slot->bits, sizeof(slot->bits), ctrl, ctrl_len, &iov, 1);
+    if (ret_len < 0)
+    {
+        return -1;
+    }
+    slot->len = (uint16_t)ret_len;
+    slot->nr = c->vr;
+    return 0;
+}
+
+/*
+ * Sends a retained I frame again. It goes out exactly as first sent unless
+ * we received I frames since, and its N(R) has to be advanced.
+ */
+static void ax25_conn_resend(ax25_conn_t *c, uint8_t ns)
+{
+    ax25_conn_slot_t *slot = ax25_conn_slot(c, ns);
+
+    if (slot->nr != c->vr && ax25_conn_rebuild(c, slot, ns) < 0)
+    {
+        return;
+    }
+    slot->retx = 1;
+    ax25_conn_transmit(c, slot->bits, slot->len);
+    c->ack_pending = 0;
+    c->t2_running = 0;
+}
+
+/*
+ * Clears the sequence variables, on link setup and release. The caller is
+ * told of the I frames dropped with them.
+ */
+static void ax25_conn_reset(ax25_conn_t *c)
+{
+    size_t dropped = ax25_conn_outstanding(c);
+
+    if (dropped && c->on_reset)
+    {
+        c->on_reset(c->user, dropped);
+    }
+    c->vs = c->va = c->vr = 0;
+    c->peer_busy = 0;
+    c->rej_sent = 0;
+    c->ack_pending = 0;
+    c->peer_up = 0;
+    c->retries = 0;
+    c->t1_running = 0;
+    c->t2_running = 0;
+}
+
+/*
+ * Feeds a round trip sample to the smoothed estimators of RFC 6298, with
+ * the ms clock as granularity
+ */
+static void ax25_conn_rtt_sample(ax25_conn_t *c, uint32_t rtt)
+{
+    uint32_t t1;
+
+    if (!c->rtt_valid)
+    {
+        c->srtt = rtt;
+        c->rttvar = rtt / 2;
+        c->rtt_valid = 1;
+    }
+    else
+    {
+        uint32_t err = c->srtt > rtt ? c->srtt - rtt : rtt - c->srtt;
+
+        c->rttvar = (3 * c->rttvar + err) / 4;
+        c->srtt = (7 * c->srtt + rtt) / 8;
+    }
+    t1 = c->srtt + (4 * c->rttvar > 1 ? 4 * c->rttvar : 1);
+    if (t1 < c->cfg.t1_min)
+    {
+        t1 = c->cfg.t1_min;
+    }
+    if (t1 > c->cfg.t1_max)
+    {
+        t1 = c->cfg.t1_max;
+    }
+    c->t1 = t1;
+}
+
+/*
+ * Takes the N(R) of a received I or S frame: releases the frames it
+ * acknowledges and restarts T1 for the rest
+ * @return 0, or -1 if nr is outside the window
+ */
+static int ax25_conn_ack(ax25_conn_t *c, uint8_t nr, uint32_t now)
+{
+    uint8_t acked = ax25_conn_seq(c, (uint32_t)nr - c->va + c->modulus);
+    uint8_t fresh = 0;
+    uint32_t sent = 0;
+
+    if (acked > ax25_conn_outstanding(c))
+    {
+        return -1;
+    }
+    if (!acked)
+    {
+        return 0;
+    }
+    while (c->va != nr)
+    {
+        ax25_conn_slot_t *slot = ax25_conn_slot(c, c->va);
+
+        /* Karn: retransmitted frames say nothing about the round trip */
+        if (!slot->retx)
+        {
+            fresh = 1;
+            sent = slot->sent;
+        }
+        c->va = ax25_conn_seq(c, c->va + 1);
+    }
+    if (fresh)
+    {
+        ax25_conn_rtt_sample(c, now - sent);
+    }
+    c->retries = 0;
+    if (c->va == c->vs)
+    {
+        c->t1_running = 0;
+    }
+    else
+    {
+        ax25_conn_start_t1(c, now);
+    }
+    return 0;
+}
+
+/*
+ * Sends again every unacknowledged frame, from V(A) on (go-back-N). The
+ * retained frames carry no poll, so a poll is sent after them as RR.
+ */
+static void ax25_conn_resend_all(ax25_conn_t *c, uint8_t poll)
+{
+    uint8_t ns;
+
+    for (ns = c->va; ns != c->vs; ns = ax25_conn_seq(c, ns + 1))
+    {
+        ax25_conn_resend(c, ns);
+    }
+    if (poll)
+    {
+        ax25_conn_send_s(c, 1, AX25_CTRL_RR, 1);
+    }
+}
+
+/**
+ * Prepares a disconnected link
+ * @param c the link
+ * @param cfg settings, copied
+ * @param local our callsign, 6 characters
+ * @param local_ssid our SSID
+ * @param remote the peer's callsign, 6 characters
+ * @param remote_ssid the peer's SSID
+ * @param send called with every frame to transmit
+ * @param recv called with the info field of the I frames received in order
+ * @param user opaque pointer handed to the callbacks
+ * @return 0, or -1 if the settings are out of range
+ */
+int ax25_conn_init(ax25_conn_t *c, const ax25_conn_cfg_t *cfg, const uint8_t *local, uint8_t local_ssid, const uint8_t *remote, uint8_t remote_ssid, ax25_conn_send_cb_t send, ax25_conn_recv_cb_t recv, void *user)
+{
+    uint8_t modulus = cfg->mod128 ? 128 : 8;
+
+    if (cfg->window == 0 || cfg->window >= modulus || cfg->window > AX25_CONN_MAX_WINDOW || cfg->t1_min > cfg->t1_max || !send || !recv)
+    {
+        return -1;
+    }
+    memset(c, 0, sizeof(*c));
+    c->cfg = *cfg;
+    c->modulus = modulus;
+    c->t1 = cfg->t1_init;
+    ax25_enc_init(&c->cmd, remote, remote_ssid, local, local_ssid);
+    ax25_conn_set_c_bits(&c->cmd, 1);
+    c->rsp = c->cmd;
+    ax25_conn_set_c_bits(&c->rsp, 0);
+    ax25_create_addr_field(c->peer_addr, local, local_ssid, remote, remote_ssid);
+    c->peer_addr[6] &= ~AX25_CONN_C_BIT;
+    c->peer_addr[13] &= ~AX25_CONN_C_BIT;
+    c->state = AX25_CONN_DISCONNECTED;
+    c->send = send;
+    c->recv = recv;
+    c->user = user;
+    return 0;
+}
+
+/**
+ * Selects the line coding of the frames the link sends. The frames are
+ * encoded without it and coded as they go out, so the coder state runs on
+ * from one frame to the next, retransmissions included.
+ * @param c the link
+ * @param line AX25_LINE_NONE or a combination of AX25_LINE_NRZI and
+ * AX25_LINE_G3RUH
+ */
+void ax25_conn_set_line_coding(ax25_conn_t *c, uint8_t line)
+{
+    ax25_line_init(&c->coder, line);
+}
+
+/**
+ * Starts link setup with SABM, or SABME for modulo 128. Retried on T1
+ * until the peer answers UA, or gives up after N2 tries.
+ * @param c the link
+ * @param now current time in ms
+ */
+void ax25_conn_connect(ax25_conn_t *c, uint32_t now)
+{
+    ax25_conn_reset(c);
+    c->state = AX25_CONN_CONNECTING;
+    c->t1_start = now;
+    ax25_conn_send_u(c, 1, c->cfg.mod128 ? AX25_CTRL_SABME : AX25_CTRL_SABM, 1);
+    ax25_conn_start_t1(c, now);
+}
+
+/**
+ * Starts link release with DISC. Frames not yet acknowledged are dropped
+ * and reported to c->on_reset.
+ * @param c the link
+ * @param now current time in ms
+ */
+void ax25_conn_disconnect(ax25_conn_t *c, uint32_t now)
+{
+    if (c->state == AX25_CONN_DISCONNECTED)
+    {
+        return;
+    }
+    ax25_conn_reset(c);
+    c->state = AX25_CONN_DISCONNECTING;
+    c->t1_start = now;
+    ax25_conn_send_u(c, 1, AX25_CTRL_DISC, 1);
+    ax25_conn_start_t1(c, now);
+}
+
+/**
+ * @param c the link
+ * @return the number of I frames ax25_conn_send() would take now
+ */
+size_t ax25_conn_window_free(const ax25_conn_t *c)
+{
+    if (c->state != AX25_CONN_CONNECTED || c->peer_busy)
+    {
+        return 0;
+    }
+    return c->cfg.window - ax25_conn_outstanding(c);
+}
+
+/**
+ * Sends an I frame. It is encoded into the retention pool and kept there,
+ * ready to go again, until acknowledged.
+ * @param c the link
+ * @param data the info field
+ * @param len length of data, up to AX25_MAX_FRAME_LEN
+ * @param now current time in ms
+ * @return 0, or -1 if the link is not connected, the window is full or
+ * the peer is busy
+ */
+int ax25_conn_send(ax25_conn_t *c, const uint8_t *data, size_t len, uint32_t now)
+{
+    ax25_conn_slot_t *slot;
+    ax25_iovec_t iov = { data, len };
+    size_t ctrl_len;
+    uint16_t ctrl;
+    int32_t ret_len;
+
+    if (len > AX25_MAX_FRAME_LEN || ax25_conn_window_free(c) == 0)
+    {
+        return -1;
+    }
+    /* Encoded once, straight into the pool */
+    slot = ax25_conn_slot(c, c->vs);
+    ctrl = ax25_ctrl_i(c->vs, c->vr, 0, c->cfg.mod128, &ctrl_len);
+    ret_len = ax25_encode_ctrl_iov(&c->cmd, slot->bits, sizeof(slot->bits), ctrl, ctrl_len, &iov, 1);
+    if (ret_len < 0)
+    {
+        return -1;
+    }
+    slot->len = (uint16_t)ret_len;
+    slot->nr = c->vr;
+    slot->sent = now;
+    slot->retx = 0;
+    ax25_conn_transmit(c, slot->bits, slot->len);
+    c->ack_pending = 0;
+    c->t2_running = 0;
+    c->vs = ax25_conn_seq(c, c->vs + 1);
+    if (!c->t1_running)
+    {
+        ax25_conn_start_t1(c, now);
+    }
+    return 0;
+}
+
+/* Acknowledges received I frames now, or once T2 runs out */
+static void ax25_conn_ack_later(ax25_conn_t *c, uint32_t now)
+{
+    c->ack_pending++;
+    if (c->cfg.t2 == 0 || c->ack_pending >= (c->cfg.window + 1) / 2)
+    {
+        ax25_conn_send_s(c, 0, AX25_CTRL_RR, 0);
+    }
+    else if (!c->t2_running)
+    {
+        c->t2_running = 1;
+        c->t2_expiry = now + c->cfg.t2;
+    }
+}
+
+static void ax25_conn_input_i(ax25_conn_t *c, const ax25_ctrl_info_t *fi, const uint8_t *frame, size_t len, uint32_t now)
+{
+    if (fi->ns != c->vr)
+    {
+        /* Out of sequence: ask once for everything from V(R) on */
+        if (!c->rej_sent)
+        {
+            c->rej_sent = 1;
+            ax25_conn_send_s(c, 0, AX25_CTRL_REJ, fi->pf);
+        }
+        else if (fi->pf)
+        {
+            ax25_conn_send_s(c, 0, AX25_CTRL_RR, 1);
+        }
+        return;
+    }
+    c->vr = ax25_conn_seq(c, c->vr + 1);
+    c->rej_sent = 0;
+    c->recv(c->user, frame + fi->info_off, len - fi->info_off);
+    if (fi->pf)
+    {
+        ax25_conn_send_s(c, 0, AX25_CTRL_RR, 1);
+    }
+    else
+    {
+        ax25_conn_ack_later(c, now);
+    }
+}
+
+static void ax25_conn_input_s(ax25_conn_t *c, const ax25_ctrl_info_t *fi)
+{
+    if (fi->code == AX25_CTRL_RNR)
+    {
+        c->peer_busy = 1;
+    }
+    else
+    {
+        c->peer_busy = 0;
+    }
+
+    if (fi->code == AX25_CTRL_REJ)
+    {
+        ax25_conn_resend_all(c, 0);
+    }
+    else if (fi->code == AX25_CTRL_SREJ && fi->nr != c->vs)
+    {
+        ax25_conn_resend(c, fi->nr);
+    }
+
+    /* A poll asks for our state straight away */
+    if (fi->command && fi->pf)
+    {
+        ax25_conn_send_s(c, 0, AX25_CTRL_RR, 1);
+    }
+}
+
+static void ax25_conn_input_u(ax25_conn_t *c, const ax25_ctrl_info_t *fi, uint32_t now)
+{
+    if (fi->command && (fi->code == AX25_CTRL_SABM || fi->code == AX25_CTRL_SABME))
+    {
+        /* Link setup from the peer, in our modulus only */
+        if ((fi->code == AX25_CTRL_SABME) != (c->cfg.mod128 != 0))
+        {
+            ax25_conn_send_u(c, 0, AX25_CTRL_DM, fi->pf);
+            return;
+        }
+        /*
+         * Connected but nothing heard from the peer since: our UA was
+         * lost and this is the retry. The frames already sent stay in the
+         * window, T1 sends them again.
+         */
+        if (c->state != AX25_CONN_CONNECTED || c->peer_up)
+        {
+            ax25_conn_reset(c);
+        }
+        c->state = AX25_CONN_CONNECTED;
+        ax25_conn_send_u(c, 0, AX25_CTRL_UA, fi->pf);
+    }
+    else if (fi->command && fi->code == AX25_CTRL_DISC)
+    {
+        ax25_conn_send_u(c, 0, c->state == AX25_CONN_DISCONNECTED ? AX25_CTRL_DM : AX25_CTRL_UA, fi->pf);
+        ax25_conn_reset(c);
+        c->state = AX25_CONN_DISCONNECTED;
+    }
+    else if (!fi->command && fi->code == AX25_CTRL_UA)
+    {
+        if (c->state == AX25_CONN_CONNECTING)
+        {
+            /* Only the first SABM gives a clean round trip sample */
+            if (c->retries == 0)
+            {
+                ax25_conn_rtt_sample(c, now - c->t1_start);
+            }
+            ax25_conn_reset(c);
+            c->state = AX25_CONN_CONNECTED;
+        }
+        else if (c->state == AX25_CONN_DISCONNECTING)
+        {
+            ax25_conn_reset(c);
+            c->state = AX25_CONN_DISCONNECTED;
+        }
+    }
+    else if (!fi->command && (fi->code == AX25_CTRL_DM || fi->code == AX25_CTRL_FRMR))
+    {
+        ax25_conn_reset(c);
+        c->state = AX25_CONN_DISCONNECTED;
+    }
+}
+
+/**
+ * Feeds a received frame to the link. Frames from other stations are
+ * ignored, so this can be given every frame off the channel.
+ * @param c the link
+ * @param frame a frame with a valid FCS, without the FCS
+ * @param len length of frame
+ * @param now current time in ms
+ */
+void ax25_conn_input(ax25_conn_t *c, const uint8_t *frame, size_t len, uint32_t now)
+{
+    ax25_ctrl_info_t fi;
+    size_t i;
+
+    if (ax25_parse_ctrl(frame, len, c->cfg.mod128, &fi) != AX25_DEC_OK || fi.addr_len != AX25_MIN_ADDR_LEN)
+    {
+        return;
+    }
+    for (i = 0; i < AX25_MIN_ADDR_LEN; i++)
+    {
+        uint8_t b = (i == 6 || i == 13) ? frame[i] & ~AX25_CONN_C_BIT : frame[i];
+
+        if (b != c->peer_addr[i])
+        {
+            return;
+        }
+    }
+
+    if (fi.type == AX25_U_FRAME)
+    {
+        ax25_conn_input_u(c, &fi, now);
+        return;
+    }
+    if (c->state != AX25_CONN_CONNECTED || (fi.type != AX25_I_FRAME && fi.type != AX25_S_FRAME))
+    {
+        return;
+    }
+    if (fi.type == AX25_S_FRAME && fi.code == AX25_CTRL_SREJ && !fi.pf)
+    {
+        /* Without F, an SREJ acknowledges nothing, N(R) is just the frame asked for */
+        if (ax25_conn_seq(c, (uint32_t)fi.nr - c->va + c->modulus) >= ax25_conn_outstanding(c))
+        {
+            return;
+        }
+    }
+    /* A bad N(R) is dropped; T1 recovers if it was a real loss of sync */
+    else if (ax25_conn_ack(c, fi.nr, now) < 0)
+    {
+        return;
+    }
+    c->peer_up = 1;
+    if (fi.type == AX25_I_FRAME)
+    {
+        ax25_conn_input_i(c, &fi, frame, len, now);
+    }
+    else
+    {
+        ax25_conn_input_s(c, &fi);
+    }
+}
+
+/**
+ * Runs the timers of the link. T1 retransmits the unacknowledged frames
+ * and polls the peer, with the timeout doubled on each try; the link is
+ * dropped after N2 tries. T2 sends the delayed RR.
+ * @param c the link
+ * @param now current time in ms
+ */
+void ax25_conn_tick(ax25_conn_t *c, uint32_t now)
+{
+    if (c->t2_running && AX25_CONN_DUE(now, c->t2_expiry))
+    {
+        c->t2_running = 0;
+        if (c->ack_pending && c->state == AX25_CONN_CONNECTED)
+        {
+            ax25_conn_send_s(c, 0, AX25_CTRL_RR, 0);
+        }
+    }
+
+    if (!c->t1_running || !AX25_CONN_DUE(now, c->t1_expiry))
+    {
+        return;
+    }
+    c->t1_running = 0;
+    if (++c->retries > c->cfg.n2)
+    {
+        if (c->state == AX25_CONN_CONNECTED)
+        {
+            ax25_conn_send_u(c, 0, AX25_CTRL_DM, 0);
+        }
+        ax25_conn_reset(c);
+        c->state = AX25_CONN_DISCONNECTED;
+        return;
+    }
+    c->t1 = c->t1 * 2 < c->cfg.t1_max ? c->t1 * 2 : c->cfg.t1_max;
+
+    switch (c->state)
+    {
+    case AX25_CONN_CONNECTING:
+        ax25_conn_send_u(c, 1, c->cfg.mod128 ? AX25_CTRL_SABME : AX25_CTRL_SABM, 1);
+        break;
+    case AX25_CONN_DISCONNECTING:
+        ax25_conn_send_u(c, 1, AX25_CTRL_DISC, 1);
+        break;
+    case AX25_CONN_CONNECTED:
+        if (c->va == c->vs)
+        {
+            return;
+        }
+        ax25_conn_resend_all(c, 1);
+        break;
+    default:
+        return;
+    }
+    ax25_conn_start_t1(c, now);
+}
@@ -0,0 +1,173 @@
+#include "ax25_filter.h"
+
+/* Bits of an address byte holding a callsign character, and the SSID */
+#define AX25_FILTER_CALL_MASK 0xFE
+#define AX25_FILTER_SSID_MASK 0x1E
+
+/* Frame type of a modulo 8 control field */
+static uint8_t ax25_filter_type(uint8_t ctrl)
+{
+    if (!(ctrl & 0x01))
+    {
+        return AX25_I_FRAME;
+    }
+    if ((ctrl & 0x03) == 0x01)
+    {
+        return AX25_S_FRAME;
+    }
+    return (ctrl & ~AX25_CTRL_PF) == AX25_CTRL_UI ? AX25_UI_FRAME : AX25_U_FRAME;
+}
+
+static int ax25_filter_match(const ax25_filter_rule_t *r, const uint8_t *hdr)
+{
+    uint8_t type;
+    size_t i;
+
+    for (i = 0; i < AX25_MIN_ADDR_LEN; i++)
+    {
+        if ((hdr[i] ^ r->addr[i]) & r->mask[i])
+        {
+            return 0;
+        }
+    }
+    /* With digipeaters, the control and PID bytes are not received yet */
+    if (!(hdr[AX25_MIN_ADDR_LEN - 1] & 0x01))
+    {
+        return 1;
+    }
+    type = ax25_filter_type(hdr[AX25_MIN_ADDR_LEN]);
+    if (r->type != AX25_FILTER_ANY && r->type != type)
+    {
+        return 0;
+    }
+    if (r->pid != AX25_FILTER_ANY && ((type != AX25_I_FRAME && type != AX25_UI_FRAME) || r->pid != hdr[AX25_MIN_ADDR_LEN + 1]))
+    {
+        return 0;
+    }
+    return 1;
+}
+
+/* Deframer header hook: routes the frame or skips it */
+static uint8_t *ax25_rx_filter_hdr(void *user, uint8_t *hdr)
+{
+    ax25_rx_filter_t *rx = user;
+    ax25_filter_rule_t *r;
+    uint8_t *slot;
+    size_t i;
+
+    rx->match = NULL;
+    for (i = 0; i < rx->nrules; i++)
+    {
+        r = &rx->rules[i];
+        if (!ax25_filter_match(r, hdr))
+        {
+            continue;
+        }
+        if (!r->ring)
+        {
+            break;
+        }
+        slot = ax25_ring_acquire(r->ring);
+        if (!slot)
+        {
+            rx->dropped++;
+            return NULL;
+        }
+        /* hdr may be a slot left over from a frame cut short */
+        memmove(slot, hdr, AX25_DF_HDR_LEN);
+        rx->match = r;
+        return slot;
+    }
+    rx->rejected++;
+    return NULL;
+}
+
+/**
+ * Prepares a receiver with an empty filter table, which skips every frame
+ * @param rx the receiver
+ */
+void ax25_rx_filter_init(ax25_rx_filter_t *rx)
+{
+    memset(rx, 0, sizeof(*rx));
+    ax25_deframer_init(&rx->deframer, rx->scratch, AX25_MAX_RAW_FRAME_LEN);
+    rx->deframer.on_hdr = ax25_rx_filter_hdr;
+    rx->deframer.hdr_user = rx;
+}
+
+/**
+ * Appends a rule to the filter table. Rules are tried in order.
+ * @param rx the receiver
+ * @param dest the destination callsign, NULL for any
+ * @param dest_ssid the destination SSID, or AX25_FILTER_ANY
+ * @param src the source callsign, NULL for any
+ * @param src_ssid the source SSID, or AX25_FILTER_ANY
+ * @param type ax25_frame_type_t, or AX25_FILTER_ANY
+ * @param pid the PID of I and UI frames, or AX25_FILTER_ANY. Frames
+ * without a PID never match a rule with one
+ * @param ring receives the matching frames without the FCS, NULL to drop
+ * them. The receiver is its only producer
+ * @return 0, or -1 if the table is full or the ring slots are too small
+ */
+int ax25_rx_filter_add(ax25_rx_filter_t *rx, const uint8_t *dest, uint8_t dest_ssid, const uint8_t *src, uint8_t src_ssid, uint8_t type, uint8_t pid, ax25_ring_t *ring)
+{
+    ax25_filter_rule_t *r;
+
+    if (rx->nrules == AX25_FILTER_MAX_RULES || (ring && ring->slot_size < AX25_RX_RING_SLOT_SIZE))
+    {
+        return -1;
+    }
+    r = &rx->rules[rx->nrules++];
+    memset(r, 0, sizeof(*r));
+    ax25_create_addr_field(r->addr, dest ? dest : (const uint8_t *)"", dest_ssid, src ? src : (const uint8_t *)"", src_ssid);
+    if (dest)
+    {
+        memset(r->mask, AX25_FILTER_CALL_MASK, AX25_CALLSIGN_MAX_LEN);
+    }
+    if (dest_ssid != AX25_FILTER_ANY)
+    {
+        r->mask[AX25_ADDR_LEN - 1] = AX25_FILTER_SSID_MASK;
+    }
+    if (src)
+    {
+        memset(r->mask + AX25_ADDR_LEN, AX25_FILTER_CALL_MASK, AX25_CALLSIGN_MAX_LEN);
+    }
+    if (src_ssid != AX25_FILTER_ANY)
+    {
+        r->mask[AX25_MIN_ADDR_LEN - 1] = AX25_FILTER_SSID_MASK;
+    }
+    r->type = type;
+    r->pid = pid;
+    r->ring = ring;
+    return 0;
+}
+
+/**
+ * Feeds the next chunk of a packed bitstream to the receiver. Every routed
+ * frame with a valid FCS is committed to the ring of its rule.
+ * @param rx the receiver
+ * @param in received bytes, MS bit first
+ * @param len number of bytes in in
+ */
+void ax25_rx_filter_push(ax25_rx_filter_t *rx, const uint8_t *in, size_t len)
+{
+    ax25_deframer_t *d = &rx->deframer;
+    size_t n;
+
+    do
+    {
+        n = ax25_deframer_push(d, in, len);
+        in += n;
+        len -= n;
+        if (!d->frame_ready)
+        {
+            continue;
+        }
+        if (d->fcs_ok && rx->match)
+        {
+            ax25_ring_commit(rx->match->ring, d->out_len - sizeof(uint16_t));
+            rx->match->frames++;
+        }
+        rx->match = NULL;
+        d->out = rx->scratch;
+    } while (len || d->frame_ready);
+}
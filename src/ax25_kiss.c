@@ -0,0 +1,391 @@
+#include <errno.h>
+#include <unistd.h>
+
+#include "ax25_kiss.h"
+
+/*
+ * Starts the next frame of a port at its tail: the KISS header goes in the
+ * arena and the deframer writes the frame right after it
+ */
+static void ax25_kiss_open(ax25_kiss_t *k, uint8_t port)
+{
+    ax25_kiss_port_t *p = &k->ports[port];
+
+    p->arena[p->tail] = AX25_KISS_FEND;
+    p->arena[p->tail + 1] = (uint8_t)(port << 4 | AX25_KISS_CMD_DATA);
+    p->deframer.out = p->arena + p->tail + 2;
+}
+
+/*
+ * Appends a segment to the batch, merged with the previous one when they
+ * are contiguous
+ */
+static void ax25_kiss_queue(ax25_kiss_t *k, uint8_t *base, size_t len)
+{
+    struct iovec *last;
+
+    if (k->niov)
+    {
+        last = &k->iov[k->niov - 1];
+        if ((uint8_t *)last->iov_base + last->iov_len == base)
+        {
+            last->iov_len += len;
+            return;
+        }
+    }
+    k->iov[k->niov].iov_base = base;
+    k->iov[k->niov].iov_len = len;
+    k->niov++;
+}
+
+/*
+ * Queues the frame the deframer of a port just completed. A frame holding
+ * FEND or FESC is copied escaped into k->esc, any other is sent from the
+ * arena as it is, its first FCS byte replaced by the closing FEND.
+ */
+static int ax25_kiss_frame(ax25_kiss_t *k, uint8_t port)
+{
+    ax25_kiss_port_t *p = &k->ports[port];
+    ax25_deframer_t *d = &p->deframer;
+    size_t len = d->out_len - sizeof(uint16_t);
+    uint8_t *out;
+    size_t nesc = 0;
+    size_t i;
+    int ret = 0;
+
+    for (i = 0; i < len; i++)
+    {
+        nesc += d->out[i] == AX25_KISS_FEND || d->out[i] == AX25_KISS_FESC;
+    }
+    if (k->niov == AX25_KISS_MAX_IOV || (nesc && k->esc_len + 2 * len + 3 > sizeof(k->esc)))
+    {
+        ret = ax25_kiss_flush(k);
+    }
+
+    if (nesc)
+    {
+        out = k->esc + k->esc_len;
+        *out++ = AX25_KISS_FEND;
+        *out++ = (uint8_t)(port << 4 | AX25_KISS_CMD_DATA);
+        for (i = 0; i < len; i++)
+        {
+            if (d->out[i] == AX25_KISS_FEND || d->out[i] == AX25_KISS_FESC)
+            {
+                *out++ = AX25_KISS_FESC;
+                *out++ = d->out[i] == AX25_KISS_FEND ? AX25_KISS_TFEND : AX25_KISS_TFESC;
+            }
+            else
+            {
+                *out++ = d->out[i];
+            }
+        }
+        *out++ = AX25_KISS_FEND;
+        ax25_kiss_queue(k, k->esc + k->esc_len, (size_t)(out - (k->esc + k->esc_len)));
+        k->esc_len = (size_t)(out - k->esc);
+        return ret;
+    }
+
+    d->out[len] = AX25_KISS_FEND;
+    ax25_kiss_queue(k, p->arena + p->tail, len + 3);
+    p->tail += len + 3;
+    d->frame_ready = 0;
+    d->out_len = 0;
+    if (p->tail + 2 + AX25_MAX_RAW_FRAME_LEN > sizeof(p->arena))
+    {
+        return ax25_kiss_flush(k) < 0 ? -1 : ret;
+    }
+    ax25_kiss_open(k, port);
+    return ret;
+}
+
+/**
+ * Sets up a TNC front-end. Every port starts without line coding.
+ * @param k the front-end
+ * @param fd the host side: a serial port, a socket or a pipe
+ * @param nports number of radio ports, at most AX25_KISS_MAX_PORTS
+ * @param tx called with every data frame the host sends
+ * @param user opaque pointer passed to tx
+ * @return 0 on success, -1 if nports is out of range
+ */
+int ax25_kiss_init(ax25_kiss_t *k, int fd, size_t nports, ax25_kiss_tx_cb_t tx, void *user)
+{
+    size_t i;
+
+    if (nports == 0 || nports > AX25_KISS_MAX_PORTS)
+    {
+        return -1;
+    }
+    memset(k, 0, sizeof(*k));
+    k->fd = fd;
+    k->nports = nports;
+    k->tx = tx;
+    k->user = user;
+    for (i = 0; i < nports; i++)
+    {
+        ax25_deframer_init(&k->ports[i].deframer, k->ports[i].arena + 2, AX25_MAX_RAW_FRAME_LEN);
+        ax25_kiss_open(k, (uint8_t)i);
+    }
+    return 0;
+}
+
+/**
+ * Sets the line coding of the frames a port sends and receives
+ * @param k the front-end
+ * @param port the radio port
+ * @param line AX25_LINE_xxx flags
+ */
+void ax25_kiss_set_line_coding(ax25_kiss_t *k, uint8_t port, uint8_t line)
+{
+    ax25_line_init(&k->ports[port].coder, line);
+    k->ports[port].deframer.line = line;
+}
+
+/**
+ * Sets the line rate of a port, so that the TXDELAY and TXTAIL of the host
+ * are sent as flags around each frame. With 0, the default, the radio is
+ * left to handle them and only the flags the line coding needs are sent.
+ * @param k the front-end
+ * @param port the radio port
+ * @param bitrate line rate in bit/s
+ */
+void ax25_kiss_set_bitrate(ax25_kiss_t *k, uint8_t port, uint32_t bitrate)
+{
+    k->ports[port].bitrate = bitrate;
+}
+
+/* Flags filling a delay in 10 ms units */
+static size_t ax25_kiss_flags(const ax25_kiss_port_t *p, uint8_t delay)
+{
+    size_t n = (size_t)delay * p->bitrate / 800;
+
+    return n < AX25_KISS_MAX_FLAGS ? n : AX25_KISS_MAX_FLAGS;
+}
+
+/* Puts n flags, stopping at the first failure */
+static ax25_encode_status_t ax25_kiss_put_flags(ax25_stuffer_t *s, size_t n)
+{
+    while (n--)
+    {
+        if (ax25_stuffer_put_flag(s) != AX25_ENC_OK)
+        {
+            return AX25_ENC_FAIL;
+        }
+    }
+    return AX25_ENC_OK;
+}
+
+/**
+ * Deframes a block of the bitstream received by a radio. Good frames are
+ * queued for the host, which gets them at the next ax25_kiss_flush(); the
+ * queue is flushed earlier only when it fills up.
+ * @param k the front-end
+ * @param port the radio port
+ * @param in received bytes, MS bit first
+ * @param len number of bytes in in
+ * @return 0 on success, -1 if a flush forced by a full queue failed
+ */
+int ax25_kiss_radio_push(ax25_kiss_t *k, uint8_t port, const uint8_t *in, size_t len)
+{
+    ax25_deframer_t *d = &k->ports[port].deframer;
+    size_t pos = 0;
+    int ret = 0;
+
+    while (pos < len)
+    {
+        pos += ax25_deframer_push(d, in + pos, len - pos);
+        if (!d->frame_ready)
+        {
+            continue;
+        }
+        if (d->fcs_ok && ax25_kiss_frame(k, port) < 0)
+        {
+            ret = -1;
+        }
+        d->frame_ready = 0;
+        d->out_len = 0;
+    }
+    return ret;
+}
+
+/**
+ * Writes every queued frame to the host with one writev(), then moves the
+ * frames still being received to the start of their arenas. The queue is
+ * emptied even if the write fails.
+ * @param k the front-end
+ * @return 0 on success, -1 with errno set if the write failed
+ */
+int ax25_kiss_flush(ax25_kiss_t *k)
+{
+    struct iovec *iov = k->iov;
+    size_t niov = k->niov;
+    ax25_kiss_port_t *p;
+    ssize_t n;
+    size_t i;
+    int ret = 0;
+
+    while (niov)
+    {
+        n = writev(k->fd, iov, (int)niov);
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n < 0)
+        {
+            ret = -1;
+            break;
+        }
+        /* Short write: skip what went out and write the rest */
+        while (niov && (size_t)n >= iov->iov_len)
+        {
+            n -= (ssize_t)iov->iov_len;
+            iov++;
+            niov--;
+        }
+        if (niov)
+        {
+            iov->iov_base = (uint8_t *)iov->iov_base + n;
+            iov->iov_len -= (size_t)n;
+        }
+    }
+    k->niov = 0;
+    k->esc_len = 0;
+
+    for (i = 0; i < k->nports; i++)
+    {
+        p = &k->ports[i];
+        if (p->tail)
+        {
+            memmove(p->arena + 2, p->deframer.out, p->deframer.out_len);
+            p->tail = 0;
+            ax25_kiss_open(k, (uint8_t)i);
+        }
+    }
+    return ret;
+}
+
+/*
+ * Handles a frame from the host held in k->rx, its type byte first
+ */
+static void ax25_kiss_host_frame(ax25_kiss_t *k)
+{
+    const uint8_t *frame = k->rx + 1;
+    size_t len = k->rx_len - 1;
+    uint8_t port = k->rx[0] >> 4;
+    ax25_kiss_port_t *p = &k->ports[port];
+    ax25_stuffer_t s;
+    size_t preamble;
+    size_t nbits;
+
+    if (k->rx[0] == AX25_KISS_RETURN || port >= k->nports)
+    {
+        return;
+    }
+
+    switch (k->rx[0] & 0xF)
+    {
+    case AX25_KISS_CMD_DATA:
+        if (len < AX25_MIN_RAW_FRAME_LEN - sizeof(uint16_t) || len > AX25_MAX_RAW_FRAME_LEN - sizeof(uint16_t))
+        {
+            return;
+        }
+        /* At least the flags a receiver needs to lock on the line coding */
+        preamble = ax25_kiss_flags(p, p->txdelay);
+        if (preamble < AX25_LINE_SYNC_FLAGS(p->coder.line))
+        {
+            preamble = AX25_LINE_SYNC_FLAGS(p->coder.line);
+        }
+        /* Stuffed without line coding, then coded by the port's coder */
+        ax25_stuffer_init(&s, k->bits, sizeof(k->bits));
+        if (ax25_kiss_put_flags(&s, preamble + 1) != AX25_ENC_OK
+            || ax25_stuffer_put_frame(&s, frame, len) != AX25_ENC_OK
+            || ax25_kiss_put_flags(&s, ax25_kiss_flags(p, p->txtail)) != AX25_ENC_OK
+            || ax25_stuffer_finish(&s, &nbits) != AX25_ENC_OK)
+        {
+            return;
+        }
+        ax25_line_code(&p->coder, k->bits, k->bits, (nbits + 7) / 8);
+        k->tx(k->user, port, k->bits, (nbits + 7) / 8);
+        return;
+    case AX25_KISS_CMD_TXDELAY:
+        p->txdelay = len ? frame[0] : p->txdelay;
+        return;
+    case AX25_KISS_CMD_PERSIST:
+        p->persist = len ? frame[0] : p->persist;
+        return;
+    case AX25_KISS_CMD_SLOTTIME:
+        p->slottime = len ? frame[0] : p->slottime;
+        return;
+    case AX25_KISS_CMD_TXTAIL:
+        p->txtail = len ? frame[0] : p->txtail;
+        return;
+    case AX25_KISS_CMD_FULLDUPLEX:
+        p->full_duplex = len ? frame[0] : p->full_duplex;
+        return;
+    default:
+        return;
+    }
+}
+
+/**
+ * Parses bytes sent by the host. Data frames are encoded with the line
+ * coding of their port and passed to the tx callback, settings are stored
+ * in the port.
+ * @param k the front-end
+ * @param in bytes from the host
+ * @param len number of bytes in in
+ */
+void ax25_kiss_host_push(ax25_kiss_t *k, const uint8_t *in, size_t len)
+{
+    uint8_t b;
+    size_t i;
+
+    for (i = 0; i < len; i++)
+    {
+        b = in[i];
+        if (b == AX25_KISS_FEND)
+        {
+            if (k->rx_len && !k->rx_drop)
+            {
+                ax25_kiss_host_frame(k);
+            }
+            k->rx_len = 0;
+            k->rx_esc = 0;
+            k->rx_drop = 0;
+            continue;
+        }
+        if (k->rx_esc)
+        {
+            k->rx_esc = 0;
+            b = b == AX25_KISS_TFEND ? AX25_KISS_FEND : b == AX25_KISS_TFESC ? AX25_KISS_FESC : b;
+        }
+        else if (b == AX25_KISS_FESC)
+        {
+            k->rx_esc = 1;
+            continue;
+        }
+        if (k->rx_len == sizeof(k->rx))
+        {
+            k->rx_drop = 1;
+            continue;
+        }
+        k->rx[k->rx_len++] = b;
+    }
+}
+
+/**
+ * Reads one block of up to AX25_KISS_READ_LEN bytes from the host and
+ * parses it with ax25_kiss_host_push()
+ * @param k the front-end
+ * @return the read() result: bytes read, 0 at end of file or -1
+ */
+ssize_t ax25_kiss_host_read(ax25_kiss_t *k)
+{
+    ssize_t n = read(k->fd, k->in, sizeof(k->in));
+
+    if (n > 0)
+    {
+        ax25_kiss_host_push(k, k->in, (size_t)n);
+    }
+    return n;
+}
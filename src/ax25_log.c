@@ -0,0 +1,156 @@
+#include "ax25_log.h"
+
+/* Same publication scheme as the frame rings of ax25_ring.c */
+#define AX25_LOG_LOAD(p)     __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define AX25_LOG_STORE(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#define AX25_LOG_INC(p)      __atomic_fetch_add((p), 1, __ATOMIC_RELAXED)
+
+ax25_log_t ax25_log;
+
+static const char *const ax25_log_levels[] = { "none", "error", "warn", "info", "debug" };
+
+static const char *const ax25_log_formats[AX25_LOG_NEVENTS] =
+  {
+    "encoded %u bytes, frame type %u",
+    "bad FCS, %u bytes, FCS %04x, received %04x",
+    "abort after %u bytes",
+    "frame longer than %u bytes",
+    "frame start not found",
+    "no complete frame, %u bytes received",
+  };
+
+/**
+ * Registers the log sink. Records already in the ring are kept.
+ * @param sink called with every record, NULL to discard them
+ * @param user opaque pointer passed to sink
+ * @param level records above this level are discarded. Levels above
+ * AX25_LOG_LEVEL are never logged
+ * @param deferred 0 to call sink from the code logging the event, 1 to
+ * store the records until ax25_log_drain()
+ */
+void ax25_log_set_sink(ax25_log_sink_t sink, void *user, uint8_t level, uint8_t deferred)
+{
+    ax25_log.sink = sink;
+    ax25_log.user = user;
+    ax25_log.level = level;
+    ax25_log.deferred = deferred;
+}
+
+/* Reserves the next ring entry, returns 0 if the ring is full */
+static int ax25_log_reserve(uint32_t *head)
+{
+    *head = __atomic_load_n(&ax25_log.head, __ATOMIC_RELAXED);
+    do
+    {
+        /* Signed: a stale head may already be behind tail, the exchange then fails */
+        if ((int32_t)(*head - AX25_LOG_LOAD(&ax25_log.tail)) >= AX25_LOG_RING_LEN)
+        {
+            return 0;
+        }
+    } while (!__atomic_compare_exchange_n(&ax25_log.head, head, *head + 1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+    return 1;
+}
+
+/**
+ * Logs an event. Called through the AX25_LOG_xxx macros, from any thread
+ * or interrupt handler. In deferred mode this is a copy into the ring.
+ * @param level AX25_LOG_ERROR to AX25_LOG_DEBUG
+ * @param event the event
+ * @param a0 first argument of the event, 0 if unused
+ * @param a1 second argument
+ * @param a2 third argument
+ */
+void ax25_log_write(uint8_t level, ax25_log_event_t event, uint32_t a0, uint32_t a1, uint32_t a2)
+{
+    ax25_log_record_t local;
+    ax25_log_record_t *rec = &local;
+    uint32_t head = 0;
+
+    if (level > ax25_log.level || !ax25_log.sink)
+    {
+        return;
+    }
+    if (ax25_log.deferred)
+    {
+        if (!ax25_log_reserve(&head))
+        {
+            AX25_LOG_INC(&ax25_log.seq);
+            AX25_LOG_INC(&ax25_log.dropped);
+            return;
+        }
+        rec = &ax25_log.ring[head & (AX25_LOG_RING_LEN - 1)];
+    }
+    rec->seq = AX25_LOG_INC(&ax25_log.seq);
+    rec->event = (uint8_t)event;
+    rec->level = level;
+    rec->args[0] = a0;
+    rec->args[1] = a1;
+    rec->args[2] = a2;
+    if (ax25_log.deferred)
+    {
+        AX25_LOG_STORE(&ax25_log.ready[head & (AX25_LOG_RING_LEN - 1)], head + 1);
+        return;
+    }
+    ax25_log.sink(ax25_log.user, rec);
+}
+
+/**
+ * Consumer side of the deferred log: hands the oldest records to the sink.
+ * Stops at a record still being written, e.g. by an interrupted producer.
+ * @param max the most records to drain
+ * @return the number of records drained
+ */
+size_t ax25_log_drain(size_t max)
+{
+    uint32_t tail = ax25_log.tail;
+    size_t n = 0;
+
+    while (n < max && AX25_LOG_LOAD(&ax25_log.ready[tail & (AX25_LOG_RING_LEN - 1)]) == tail + 1)
+    {
+        if (ax25_log.sink)
+        {
+            ax25_log.sink(ax25_log.user, &ax25_log.ring[tail & (AX25_LOG_RING_LEN - 1)]);
+        }
+        tail++;
+        n++;
+        AX25_LOG_STORE(&ax25_log.tail, tail);
+    }
+    return n;
+}
+
+/**
+ * Formats a record as a line of text, without the newline
+ * @param buf the output buffer
+ * @param cap size of buf
+ * @param rec the record
+ * @return the snprintf() result
+ */
+int ax25_log_format(char *buf, size_t cap, const ax25_log_record_t *rec)
+{
+    int n;
+
+    if (rec->event >= AX25_LOG_NEVENTS || rec->level > AX25_LOG_DEBUG)
+    {
+        return snprintf(buf, cap, "%u: event %u", (unsigned)rec->seq, (unsigned)rec->event);
+    }
+    n = snprintf(buf, cap, "%u %s: ", (unsigned)rec->seq, ax25_log_levels[rec->level]);
+    if (n < 0 || (size_t)n >= cap)
+    {
+        return n;
+    }
+    return n + snprintf(buf + n, cap - (size_t)n, ax25_log_formats[rec->event],
+                        (unsigned)rec->args[0], (unsigned)rec->args[1], (unsigned)rec->args[2]);
+}
+
+/**
+ * Sink printing each record as a line
+ * @param user the FILE to print to
+ * @param rec the record
+ */
+void ax25_log_stdio_sink(void *user, const ax25_log_record_t *rec)
+{
+    char line[96];
+
+    ax25_log_format(line, sizeof(line), rec);
+    fprintf((FILE *)user, "AX %s\n", line);
+}
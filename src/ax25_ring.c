@@ -0,0 +1,179 @@
+#include "ax25_ring.h"
+
+/*
+ * Each index is written by one side only. The release store publishes the
+ * slot contents written before it, the acquire load of the other side
+ * makes them visible.
+ */
+#define AX25_RING_LOAD(p)     __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define AX25_RING_STORE(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+
+/**
+ * Prepares an empty ring
+ * @param r the ring
+ * @param slots storage of AX25_RING_SLOTS * slot_size bytes
+ * @param slot_size bytes per slot, AX25_RX_RING_SLOT_SIZE or
+ * AX25_TX_RING_SLOT_SIZE
+ */
+void ax25_ring_init(ax25_ring_t *r, uint8_t *slots, size_t slot_size)
+{
+    memset(r, 0, sizeof(*r));
+    r->slots = slots;
+    r->slot_size = slot_size;
+}
+
+/**
+ * Producer side: returns the next free slot, to be filled in place
+ * @param r the ring
+ * @return the slot, slot_size bytes long, or NULL if the ring is full
+ */
+uint8_t *ax25_ring_acquire(ax25_ring_t *r)
+{
+    uint32_t head = r->head;
+
+    if (head - AX25_RING_LOAD(&r->tail) == AX25_RING_SLOTS)
+    {
+        return NULL;
+    }
+    return r->slots + (head & (AX25_RING_SLOTS - 1)) * r->slot_size;
+}
+
+/**
+ * Producer side: hands the slot returned by ax25_ring_acquire() over to
+ * the consumer
+ * @param r the ring
+ * @param len bytes written to the slot
+ */
+void ax25_ring_commit(ax25_ring_t *r, size_t len)
+{
+    uint32_t head = r->head;
+
+    r->len[head & (AX25_RING_SLOTS - 1)] = (uint16_t)len;
+    AX25_RING_STORE(&r->head, head + 1);
+}
+
+/**
+ * Consumer side: returns the oldest committed slot, read in place
+ * @param r the ring
+ * @param len receives the bytes used in the slot
+ * @return the slot, or NULL if the ring is empty
+ */
+const uint8_t *ax25_ring_peek(ax25_ring_t *r, size_t *len)
+{
+    uint32_t tail = r->tail;
+
+    if (AX25_RING_LOAD(&r->head) == tail)
+    {
+        return NULL;
+    }
+    *len = r->len[tail & (AX25_RING_SLOTS - 1)];
+    return r->slots + (tail & (AX25_RING_SLOTS - 1)) * r->slot_size;
+}
+
+/**
+ * Consumer side: gives the slot returned by ax25_ring_peek() back to the
+ * producer
+ * @param r the ring
+ */
+void ax25_ring_release(ax25_ring_t *r)
+{
+    AX25_RING_STORE(&r->tail, r->tail + 1);
+}
+
+/* Points the deframer at a free slot, or at the scratch buffer */
+static void ax25_rx_ring_target(ax25_rx_ring_t *rx)
+{
+    ax25_deframer_t *d = &rx->deframer;
+    uint8_t *slot = ax25_ring_acquire(rx->ring);
+
+    d->out = slot ? slot : rx->scratch;
+}
+
+/**
+ * Prepares a receiver feeding a ring
+ * @param rx the receiver
+ * @param ring ring with slots of at least AX25_RX_RING_SLOT_SIZE bytes.
+ * The receiver is its only producer
+ * @return 0, or -1 if the slots are too small
+ */
+int ax25_rx_ring_init(ax25_rx_ring_t *rx, ax25_ring_t *ring)
+{
+    if (ring->slot_size < AX25_RX_RING_SLOT_SIZE)
+    {
+        return -1;
+    }
+    ax25_deframer_init(&rx->deframer, rx->scratch, AX25_MAX_RAW_FRAME_LEN);
+    rx->ring = ring;
+    rx->dropped = 0;
+    ax25_rx_ring_target(rx);
+    return 0;
+}
+
+/**
+ * Feeds the next chunk of a packed bitstream to the receiver. Every frame
+ * with a valid FCS is committed to the ring, without the FCS. Suited to
+ * interrupt context: nothing is copied or allocated.
+ * @param rx the receiver
+ * @param in received bytes, MS bit first
+ * @param len number of bytes in in
+ */
+void ax25_rx_ring_push(ax25_rx_ring_t *rx, const uint8_t *in, size_t len)
+{
+    ax25_deframer_t *d = &rx->deframer;
+    size_t n;
+
+    /* The consumer may have freed a slot; switch while no frame is stored */
+    if (d->out == rx->scratch && d->out_len == 0)
+    {
+        ax25_rx_ring_target(rx);
+    }
+
+    do
+    {
+        n = ax25_deframer_push(d, in, len);
+        in += n;
+        len -= n;
+        if (!d->frame_ready)
+        {
+            continue;
+        }
+        if (d->fcs_ok && d->out != rx->scratch)
+        {
+            ax25_ring_commit(rx->ring, d->out_len - sizeof(uint16_t));
+        }
+        else if (d->fcs_ok)
+        {
+            rx->dropped++;
+        }
+        /* Hands out the same slot again if nothing was committed */
+        ax25_rx_ring_target(rx);
+    } while (len || d->frame_ready);
+}
+
+/**
+ * Encodes a frame straight into the next free slot of a TX ring
+ * @param r ring with slots of at least AX25_TX_RING_SLOT_SIZE bytes
+ * @param ctx the encoder context
+ * @param in the info field
+ * @param inlen length of in
+ * @param type ax25 frame type
+ * @return the length of the encoded frame, or -1 if the ring is full or
+ * the frame could not be encoded
+ */
+int32_t ax25_tx_ring_encode(ax25_ring_t *r, const ax25_enc_ctx_t *ctx, const uint8_t *in, size_t inlen, ax25_frame_type_t type)
+{
+    uint8_t *slot = ax25_ring_acquire(r);
+    int32_t ret_len;
+
+    if (!slot)
+    {
+        return -1;
+    }
+    ret_len = ax25_encode_into(ctx, slot, r->slot_size, in, inlen, type);
+    if (ret_len < 0)
+    {
+        return -1;
+    }
+    ax25_ring_commit(r, ret_len);
+    return ret_len;
+}
@@ -0,0 +1,285 @@
+#include "ax25_rx_group.h"
+
+/* FNV-1a, to tell apart frames that share an FCS */
+static uint32_t ax25_rx_group_hash(const uint8_t *frame, size_t len)
+{
+    uint32_t h = 2166136261U;
+    size_t i;
+
+    for (i = 0; i < len; i++)
+    {
+        h = (h ^ frame[i]) * 16777619U;
+    }
+    return h;
+}
+
+/* Keeps a frame with a valid FCS until the streams are merged */
+static void ax25_rx_group_keep(ax25_rx_group_stream_t *s, const ax25_deframer_t *d, uint64_t pos)
+{
+    ax25_rx_group_frame_t *f;
+    size_t cap;
+
+    if (s->nframes == s->frames_cap)
+    {
+        cap = s->frames_cap ? 2 * s->frames_cap : 8;
+        f = realloc(s->frames, cap * sizeof(*f));
+        if (!f)
+        {
+            s->failed = 1;
+            return;
+        }
+        s->frames = f;
+        s->frames_cap = cap;
+    }
+    f = &s->frames[s->nframes++];
+    f->pos = pos;
+    f->len = (uint16_t)(d->out_len - sizeof(uint16_t));
+    f->fcs = (((uint16_t)d->out[d->out_len - 2]) << 8) | d->out[d->out_len - 1];
+    memcpy(f->data, d->out, f->len);
+    f->hash = ax25_rx_group_hash(f->data, f->len);
+}
+
+/* Decodes the current chunk of a stream, like ax25_rx_push() */
+static void ax25_rx_group_decode(ax25_rx_group_stream_t *s)
+{
+    ax25_deframer_t *d = &s->rx.deframer;
+    const uint8_t *in = s->in;
+    size_t len = s->in_len;
+    size_t n;
+
+    s->nframes = 0;
+    do
+    {
+        n = ax25_deframer_push(d, in, len);
+        in += n;
+        len -= n;
+        if (d->frame_ready && !d->fcs_ok && s->rx.recover && ax25_fcs_recover(d->out, d->out_len, NULL, s->rx.recover) > 0)
+        {
+            d->fcs_ok = 1;
+        }
+        if (d->frame_ready && d->fcs_ok)
+        {
+            ax25_rx_group_keep(s, d, s->pos + (uint64_t)(in - s->in));
+        }
+    } while (len || d->frame_ready);
+    s->pos += s->in_len;
+}
+
+static void *ax25_rx_group_worker(void *arg)
+{
+    ax25_rx_group_t *g = arg;
+    uint32_t gen = 0;
+    size_t i;
+
+    pthread_mutex_lock(&g->lock);
+    for (;;)
+    {
+        while (!g->stop && (gen == g->gen || g->next_stream == g->nstreams))
+        {
+            pthread_cond_wait(&g->work_cv, &g->lock);
+        }
+        if (g->stop)
+        {
+            break;
+        }
+        gen = g->gen;
+        while (g->next_stream < g->nstreams)
+        {
+            i = g->next_stream++;
+            pthread_mutex_unlock(&g->lock);
+            ax25_rx_group_decode(&g->streams[i]);
+            pthread_mutex_lock(&g->lock);
+            if (--g->pending == 0)
+            {
+                pthread_cond_signal(&g->done_cv);
+            }
+        }
+    }
+    pthread_mutex_unlock(&g->lock);
+    return NULL;
+}
+
+/*
+ * Checks a frame of a stream against the recently reported ones, and
+ * remembers it. It is a copy of one only if that stream did not decode
+ * the reported frame already.
+ */
+static int ax25_rx_group_is_dup(ax25_rx_group_t *g, size_t stream, const ax25_rx_group_frame_t *f)
+{
+    ax25_rx_group_seen_t *e;
+    size_t i;
+
+    for (i = 0; i < AX25_RX_GROUP_RECENT; i++)
+    {
+        e = &g->recent[i];
+        if (e->len && e->len == f->len && e->fcs == f->fcs && e->hash == f->hash
+            && f->pos - e->pos <= g->dedup_window && !(e->streams & (1U << stream)))
+        {
+            e->streams |= (uint16_t)(1U << stream);
+            return 1;
+        }
+    }
+    e = &g->recent[g->recent_next];
+    g->recent_next = (g->recent_next + 1) % AX25_RX_GROUP_RECENT;
+    e->pos = f->pos;
+    e->hash = f->hash;
+    e->fcs = f->fcs;
+    e->len = f->len;
+    e->streams = (uint16_t)(1U << stream);
+    return 0;
+}
+
+/* Reports the frames of all streams by position, dropping duplicates */
+static void ax25_rx_group_merge(ax25_rx_group_t *g)
+{
+    size_t head[AX25_RX_GROUP_MAX_STREAMS] = {0};
+    const ax25_rx_group_frame_t *f;
+    const ax25_rx_group_frame_t *first;
+    size_t stream = 0;
+    size_t i;
+
+    for (;;)
+    {
+        first = NULL;
+        for (i = 0; i < g->nstreams; i++)
+        {
+            if (head[i] == g->streams[i].nframes)
+            {
+                continue;
+            }
+            f = &g->streams[i].frames[head[i]];
+            if (!first || f->pos < first->pos)
+            {
+                first = f;
+                stream = i;
+            }
+        }
+        if (!first)
+        {
+            return;
+        }
+        head[stream]++;
+        if (!ax25_rx_group_is_dup(g, stream, first) && g->on_frame)
+        {
+            g->on_frame(g->user, stream, first->data, first->len);
+        }
+    }
+}
+
+/**
+ * Prepares a group of receivers and starts its workers
+ * @param g the group
+ * @param nstreams number of bitstreams, up to AX25_RX_GROUP_MAX_STREAMS
+ * @param nworkers worker threads, at most nstreams. With 0 the streams are
+ * decoded by the caller of ax25_rx_group_push()
+ * @param on_frame called for every distinct frame with a valid FCS
+ * @param user opaque pointer passed to on_frame
+ * @return 0 on success, -1 on invalid arguments or if a thread could not
+ * be started
+ */
+int ax25_rx_group_init(ax25_rx_group_t *g, size_t nstreams, size_t nworkers, ax25_rx_group_cb_t on_frame, void *user)
+{
+    size_t i;
+
+    if (nstreams == 0 || nstreams > AX25_RX_GROUP_MAX_STREAMS || nworkers > nstreams)
+    {
+        return -1;
+    }
+    memset(g, 0, sizeof(*g));
+    g->nstreams = nstreams;
+    g->dedup_window = 2 * AX25_MAX_ENCODED_LEN;
+    g->on_frame = on_frame;
+    g->user = user;
+    for (i = 0; i < nstreams; i++)
+    {
+        ax25_rx_init(&g->streams[i].rx, NULL, NULL);
+    }
+
+    pthread_mutex_init(&g->lock, NULL);
+    pthread_cond_init(&g->work_cv, NULL);
+    pthread_cond_init(&g->done_cv, NULL);
+    g->next_stream = nstreams;
+    /* Detected before the workers can race to it */
+    ax25_cpu_features();
+    for (i = 0; i < nworkers; i++)
+    {
+        if (pthread_create(&g->workers[i], NULL, ax25_rx_group_worker, g) != 0)
+        {
+            ax25_rx_group_destroy(g);
+            return -1;
+        }
+        g->nworkers++;
+    }
+    return 0;
+}
+
+/**
+ * Decodes the next chunk of every stream, in parallel, then reports the
+ * new frames in the order they were completed. The chunks must cover the
+ * same span of time for the positions of the streams to be comparable.
+ * @param g the group
+ * @param in one chunk per stream, packed bitstreams MS bit first
+ * @param len length of each chunk
+ */
+void ax25_rx_group_push(ax25_rx_group_t *g, const uint8_t *const *in, const size_t *len)
+{
+    size_t i;
+
+    for (i = 0; i < g->nstreams; i++)
+    {
+        g->streams[i].in = in[i];
+        g->streams[i].in_len = len[i];
+    }
+
+    if (g->nworkers == 0)
+    {
+        for (i = 0; i < g->nstreams; i++)
+        {
+            ax25_rx_group_decode(&g->streams[i]);
+        }
+    }
+    else
+    {
+        pthread_mutex_lock(&g->lock);
+        g->next_stream = 0;
+        g->pending = g->nstreams;
+        g->gen++;
+        pthread_cond_broadcast(&g->work_cv);
+        while (g->pending)
+        {
+            pthread_cond_wait(&g->done_cv, &g->lock);
+        }
+        pthread_mutex_unlock(&g->lock);
+    }
+
+    ax25_rx_group_merge(g);
+}
+
+/**
+ * Stops the workers and releases the memory of a group
+ * @param g the group
+ */
+void ax25_rx_group_destroy(ax25_rx_group_t *g)
+{
+    size_t i;
+
+    pthread_mutex_lock(&g->lock);
+    g->stop = 1;
+    pthread_cond_broadcast(&g->work_cv);
+    pthread_mutex_unlock(&g->lock);
+    for (i = 0; i < g->nworkers; i++)
+    {
+        pthread_join(g->workers[i], NULL);
+    }
+    g->nworkers = 0;
+    pthread_cond_destroy(&g->done_cv);
+    pthread_cond_destroy(&g->work_cv);
+    pthread_mutex_destroy(&g->lock);
+
+    for (i = 0; i < g->nstreams; i++)
+    {
+        free(g->streams[i].frames);
+        g->streams[i].frames = NULL;
+        g->streams[i].frames_cap = 0;
+    }
+}
@@ -0,0 +1,195 @@
+#include "ax25.h"
+
+/**
+ * Flag scanners. A flag or an abort needs six consecutive 1's, so a byte can
+ * only complete one if the 16 bits made of the previous byte and itself hold
+ * such a run. All of them test exactly that, the SIMD ones for a whole
+ * block of bytes at once.
+ */
+
+#if AX25_SCAN_BACKEND == AX25_SCAN_SIMD && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define AX25_SCAN_HAVE_SSE2 1
+#endif
+
+#if AX25_SCAN_BACKEND == AX25_SCAN_SIMD && defined(__aarch64__)
+#include <arm_neon.h>
+#define AX25_SCAN_HAVE_NEON 1
+#endif
+
+/* Bytes tested one at a time before switching to the vector kernels */
+#define AX25_SCAN_SCALAR_LEAD 16
+
+/* Non zero if w holds 6 consecutive 1's */
+#define AX25_SCAN_ONES6(w) ((w) & ((w) >> 1) & ((w) >> 2) & ((w) >> 3) & ((w) >> 4) & ((w) >> 5))
+
+static inline size_t ax25_flag_scan_scalar(const uint8_t *in, size_t len, uint8_t prev)
+{
+    uint16_t w;
+    size_t i;
+
+    for (i = 0; i < len; i++)
+    {
+        w = (uint16_t)prev << 8 | in[i];
+        if (AX25_SCAN_ONES6(w))
+        {
+            return i;
+        }
+        prev = in[i];
+    }
+    return len;
+}
+
+#if AX25_SCAN_HAVE_SSE2
+/* Runs of 6 ones in the 16-bit lanes, built as 2 runs of 4 overlapping by 2 */
+#define AX25_SCAN_ONES6_EPI16(w, srli, and) \
+    do \
+    { \
+        (w) = and((w), srli((w), 1)); \
+        (w) = and((w), srli((w), 2)); \
+        (w) = and((w), srli((w), 2)); \
+    } while (0)
+
+/*
+ * Pairs every byte of v with the byte before it in p, in 16-bit lanes, and
+ * reports whether any lane holds a candidate
+ */
+__attribute__((target("sse2")))
+static inline int ax25_flag_scan_sse2_block(const uint8_t *in)
+{
+    __m128i v = _mm_loadu_si128((const __m128i *)in);
+    __m128i p = _mm_loadu_si128((const __m128i *)(in - 1));
+    __m128i lo = _mm_unpacklo_epi8(v, p);
+    __m128i hi = _mm_unpackhi_epi8(v, p);
+
+    AX25_SCAN_ONES6_EPI16(lo, _mm_srli_epi16, _mm_and_si128);
+    AX25_SCAN_ONES6_EPI16(hi, _mm_srli_epi16, _mm_and_si128);
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_or_si128(lo, hi), _mm_setzero_si128())) != 0xFFFF;
+}
+
+/* 32 bytes per iteration. in[-1] must be readable */
+__attribute__((target("sse2")))
+static size_t ax25_flag_scan_sse2(const uint8_t *in, size_t len)
+{
+    size_t i = 0;
+
+    while (i + 32 <= len)
+    {
+        if (ax25_flag_scan_sse2_block(in + i) || ax25_flag_scan_sse2_block(in + i + 16))
+        {
+            break;
+        }
+        i += 32;
+    }
+    return i + ax25_flag_scan_scalar(in + i, len - i, in[i - 1]);
+}
+
+/*
+ * 64 bytes per iteration. unpack works within each 128-bit half, which
+ * keeps every byte paired with its predecessor. in[-1] must be readable
+ */
+__attribute__((target("avx2")))
+static size_t ax25_flag_scan_avx2(const uint8_t *in, size_t len)
+{
+    __m256i v0, p0, v1, p1, acc;
+    __m256i w[4];
+    size_t i = 0;
+    int k;
+
+    while (i + 64 <= len)
+    {
+        v0 = _mm256_loadu_si256((const __m256i *)(in + i));
+        p0 = _mm256_loadu_si256((const __m256i *)(in + i - 1));
+        v1 = _mm256_loadu_si256((const __m256i *)(in + i + 32));
+        p1 = _mm256_loadu_si256((const __m256i *)(in + i + 31));
+        w[0] = _mm256_unpacklo_epi8(v0, p0);
+        w[1] = _mm256_unpackhi_epi8(v0, p0);
+        w[2] = _mm256_unpacklo_epi8(v1, p1);
+        w[3] = _mm256_unpackhi_epi8(v1, p1);
+        acc = _mm256_setzero_si256();
+        for (k = 0; k < 4; k++)
+        {
+            AX25_SCAN_ONES6_EPI16(w[k], _mm256_srli_epi16, _mm256_and_si256);
+            acc = _mm256_or_si256(acc, w[k]);
+        }
+        if (!_mm256_testz_si256(acc, acc))
+        {
+            break;
+        }
+        i += 64;
+    }
+    return i + ax25_flag_scan_sse2(in + i, len - i);
+}
+#endif
+
+#if AX25_SCAN_HAVE_NEON
+static inline uint16x8_t ax25_flag_scan_neon_ones6(uint16x8_t w)
+{
+    w = vandq_u16(w, vshrq_n_u16(w, 1));
+    w = vandq_u16(w, vshrq_n_u16(w, 2));
+    return vandq_u16(w, vshrq_n_u16(w, 2));
+}
+
+/* 32 bytes per iteration. in[-1] must be readable */
+static size_t ax25_flag_scan_neon(const uint8_t *in, size_t len)
+{
+    uint8x16_t v0, p0, v1, p1;
+    uint16x8_t acc;
+    size_t i = 0;
+
+    while (i + 32 <= len)
+    {
+        v0 = vld1q_u8(in + i);
+        p0 = vld1q_u8(in + i - 1);
+        v1 = vld1q_u8(in + i + 16);
+        p1 = vld1q_u8(in + i + 15);
+        acc = ax25_flag_scan_neon_ones6(vreinterpretq_u16_u8(vzip1q_u8(v0, p0)));
+        acc = vorrq_u16(acc, ax25_flag_scan_neon_ones6(vreinterpretq_u16_u8(vzip2q_u8(v0, p0))));
+        acc = vorrq_u16(acc, ax25_flag_scan_neon_ones6(vreinterpretq_u16_u8(vzip1q_u8(v1, p1))));
+        acc = vorrq_u16(acc, ax25_flag_scan_neon_ones6(vreinterpretq_u16_u8(vzip2q_u8(v1, p1))));
+        if (vmaxvq_u16(acc))
+        {
+            break;
+        }
+        i += 32;
+    }
+    return i + ax25_flag_scan_scalar(in + i, len - i, in[i - 1]);
+}
+#endif
+
+/**
+ * Finds the first byte of a packed bitstream (MS bit first) that may
+ * complete a flag or an abort sequence. No byte before the returned one can produce either, so a receiver hunting
+ * for a flag can skip them. Uses the backend selected by AX25_SCAN_BACKEND.
+ * @param in received bytes
+ * @param len number of bytes in in
+ * @param prev the byte received before in, or one ending with the pending
+ * run of 1's
+ * @return the index of the candidate byte, or len if there is none
+ */
+size_t ax25_flag_scan(const uint8_t *in, size_t len, uint8_t prev)
+{
+    size_t i;
+
+    /*
+     * Noisy input holds a candidate every few bytes: look at the first ones
+     * with the scalar loop before paying for a vector block. This also
+     * gives the kernels the byte they look back at.
+     */
+    i = ax25_flag_scan_scalar(in, len < AX25_SCAN_SCALAR_LEAD ? len : AX25_SCAN_SCALAR_LEAD, prev);
+    if (i < AX25_SCAN_SCALAR_LEAD)
+    {
+        return i;
+    }
+#if AX25_SCAN_HAVE_SSE2
+    if (ax25_cpu_features() & AX25_CPU_AVX2)
+    {
+        return i + ax25_flag_scan_avx2(in + i, len - i);
+    }
+    return i + ax25_flag_scan_sse2(in + i, len - i);
+#elif AX25_SCAN_HAVE_NEON
+    return i + ax25_flag_scan_neon(in + i, len - i);
+#else
+    return i + ax25_flag_scan_scalar(in + i, len - i, in[i - 1]);
+#endif
+}
@@ -0,0 +1,463 @@
+#include "ax25_seg.h"
+
+/**
+ * Returns the number of segments a payload is cut into
+ * @param len length of the payload
+ * @param seg_len payload bytes per segment, 1 to AX25_SEG_MAX_DATA
+ * @return the number of segments, at least 1
+ */
+size_t ax25_seg_count(size_t len, size_t seg_len)
+{
+    return len ? (len + seg_len - 1) / seg_len : 1;
+}
+
+/**
+ * Returns the worst case size of a transfer encoded by ax25_seg_encode()
+ * @param len length of the payload
+ * @param seg_len payload bytes per segment
+ * @return the size in bytes that ax25_seg_encode() may need
+ */
+size_t ax25_seg_encoded_size_max(size_t len, size_t seg_len)
+{
+    size_t count = ax25_seg_count(len, seg_len);
+
+    /*
+     * Every frame but the last carries seg_len bytes. Flags are shared, so
+     * summing whole frames overestimates by one flag per frame
+     */
+    return (count - 1) * ax25_encoded_size_max(AX25_SEG_HDR_LEN + seg_len)
+           + ax25_encoded_size_max(AX25_SEG_HDR_LEN + len - (count - 1) * seg_len);
+}
+
+/* Builds the info field of the next segment: its header and payload slice */
+static void ax25_seg_next_iov(ax25_seg_tx_t *st, ax25_iovec_t *iov)
+{
+    size_t off = (size_t)st->seg_next * st->seg_len;
+
+    st->hdr[0] = (st->xfer_id >> 8) & 0xFF;
+    st->hdr[1] = st->xfer_id & 0xFF;
+    st->hdr[2] = (st->seg_next >> 8) & 0xFF;
+    st->hdr[3] = st->seg_next & 0xFF;
+    st->hdr[4] = (st->seg_count >> 8) & 0xFF;
+    st->hdr[5] = st->seg_count & 0xFF;
+    iov[0].base = st->hdr;
+    iov[0].len = AX25_SEG_HDR_LEN;
+    iov[1].base = st->data + off;
+    iov[1].len = (st->len - off < st->seg_len) ? st->len - off : st->seg_len;
+    st->seg_next++;
+}
+
+/* Source callback of the transmitter: loads the next segment, if any */
+static ax25_encode_status_t ax25_seg_tx_load(void *user, ax25_tx_t *tx)
+{
+    ax25_seg_tx_t *st = user;
+    ax25_iovec_t iov[2];
+
+    if (st->seg_next == st->seg_count)
+    {
+        return AX25_ENC_FAIL;
+    }
+    ax25_seg_next_iov(st, iov);
+    return ax25_tx_load(tx, st->ctx, iov, 2, AX25_UI_FRAME);
+}
+
+/**
+ * Prepares the transmission of a payload as a train of UI frames, pulled
+ * out with ax25_seg_tx_next_chunk(). The payload is referenced, not
+ * copied, and must stay valid until the transmission is done.
+ * @param st the transmitter state
+ * @param ctx the encoder context holding the address field
+ * @param xfer_id identifies the transfer at the receiver
+ * @param data the payload
+ * @param len length of data, at most AX25_SEG_MAX_PAYLOAD for seg_len bytes
+ * per segment
+ * @param seg_len payload bytes per segment, 1 to AX25_SEG_MAX_DATA
+ * @return AX25_ENC_FAIL if the payload cannot be sent this way
+ */
+ax25_encode_status_t ax25_seg_tx_start(ax25_seg_tx_t *st, const ax25_enc_ctx_t *ctx, uint16_t xfer_id, const uint8_t *data, size_t len, size_t seg_len)
+{
+    ax25_iovec_t iov[2];
+
+    if (seg_len == 0 || seg_len > AX25_SEG_MAX_DATA || ax25_seg_count(len, seg_len) > UINT16_MAX)
+    {
+        return AX25_ENC_FAIL;
+    }
+    st->ctx = ctx;
+    st->data = data;
+    st->len = len;
+    st->seg_len = seg_len;
+    st->xfer_id = xfer_id;
+    st->seg_count = (uint16_t)ax25_seg_count(len, seg_len);
+    st->seg_next = 0;
+
+    ax25_seg_next_iov(st, iov);
+    if (ax25_tx_start(&st->tx, ctx, iov, 2, AX25_UI_FRAME) != AX25_ENC_OK)
+    {
+        return AX25_ENC_FAIL;
+    }
+    st->tx.source = ax25_seg_tx_load;
+    st->tx.source_user = st;
+    return AX25_ENC_OK;
+}
+
+/**
+ * Produces the next chunk of the transmission, see ax25_tx_next_chunk()
+ * @param st the transmitter state
+ * @param buf receives the chunk
+ * @param n size of buf
+ * @return the number of bytes written to buf. Less than n only once the
+ * transmission is done
+ */
+size_t ax25_seg_tx_next_chunk(ax25_seg_tx_t *st, uint8_t *buf, size_t n)
+{
+    return ax25_tx_next_chunk(&st->tx, buf, n);
+}
+
+/**
+ * Reports the progress of a transmission
+ * @param st the transmitter state
+ * @return the number of segments whose frame is completely stuffed
+ */
+size_t ax25_seg_tx_sent(const ax25_seg_tx_t *st)
+{
+    if (st->tx.state == AX25_TX_POSTAMBLE || st->tx.state == AX25_TX_DONE)
+    {
+        return st->seg_count;
+    }
+    return st->seg_next - 1;
+}
+
+/**
+ * Encodes a payload as a train of UI frames into one continuous bitstream,
+ * frames separated by a single flag
+ * @param ctx the encoder context holding the address field
+ * @param out receives the bitstream. ax25_seg_encoded_size_max() bytes
+ * always fit
+ * @param out_cap size of out
+ * @param xfer_id identifies the transfer at the receiver
+ * @param data the payload
+ * @param len length of data
+ * @param seg_len payload bytes per segment, 1 to AX25_SEG_MAX_DATA
+ * @return the number of bytes written to out, or -1
+ */
+int32_t ax25_seg_encode(const ax25_enc_ctx_t *ctx, uint8_t *out, size_t out_cap, uint16_t xfer_id, const uint8_t *data, size_t len, size_t seg_len)
+{
+    ax25_seg_tx_t st;
+    size_t n;
+
+    if (ax25_seg_tx_start(&st, ctx, xfer_id, data, len, seg_len) != AX25_ENC_OK)
+    {
+        return -1;
+    }
+    st.tx.preamble_len = 0;
+    st.tx.postamble_len = 0;
+    n = ax25_seg_tx_next_chunk(&st, out, out_cap);
+    /* A full buffer may still leave bits in the stuffer */
+    if (st.tx.state != AX25_TX_DONE || st.tx.s.acc_bits || n > INT32_MAX)
+    {
+        return -1;
+    }
+    return (int32_t)n;
+}
+
+/* Parked position of a last segment received before seg_len is known */
+#define AX25_SEG_PARK(x) ((size_t)((x)->seg_count - 1) * AX25_SEG_MAX_DATA)
+
+static inline uint8_t *ax25_seg_bitmap(const ax25_seg_rx_t *r, const ax25_seg_xfer_t *x)
+{
+    return r->slab + x->off;
+}
+
+static inline uint8_t *ax25_seg_data(const ax25_seg_rx_t *r, const ax25_seg_xfer_t *x)
+{
+    return r->slab + x->off + (x->seg_count + 7) / 8;
+}
+
+static ax25_seg_xfer_t *ax25_seg_rx_find(const ax25_seg_rx_t *r, uint16_t xfer_id)
+{
+    size_t i;
+
+    for (i = 0; i < AX25_SEG_RX_XFERS; i++)
+    {
+        if (r->xfers[i].in_use && r->xfers[i].xfer_id == xfer_id)
+        {
+            return (ax25_seg_xfer_t *)&r->xfers[i];
+        }
+    }
+    return NULL;
+}
+
+/* First fit: the candidates are the slab start and the end of each region */
+static int ax25_seg_rx_alloc(const ax25_seg_rx_t *r, size_t size, size_t *off)
+{
+    const ax25_seg_xfer_t *x;
+    size_t cand;
+    size_t i;
+    size_t j;
+
+    for (i = 0; i <= AX25_SEG_RX_XFERS; i++)
+    {
+        if (i == AX25_SEG_RX_XFERS)
+        {
+            cand = 0;
+        }
+        else if (r->xfers[i].in_use)
+        {
+            cand = r->xfers[i].off + r->xfers[i].size;
+        }
+        else
+        {
+            continue;
+        }
+        if (cand + size > r->slab_cap)
+        {
+            continue;
+        }
+        for (j = 0; j < AX25_SEG_RX_XFERS; j++)
+        {
+            x = &r->xfers[j];
+            if (x->in_use && cand < x->off + x->size && x->off < cand + size)
+            {
+                break;
+            }
+        }
+        if (j == AX25_SEG_RX_XFERS)
+        {
+            *off = cand;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/* Starts a transfer on its first segment, reserving room for the largest segments */
+static ax25_seg_xfer_t *ax25_seg_rx_open(ax25_seg_rx_t *r, uint16_t xfer_id, uint16_t seg_count)
+{
+    ax25_seg_xfer_t *x = NULL;
+    size_t size = (seg_count + 7) / 8 + (size_t)seg_count * AX25_SEG_MAX_DATA;
+    size_t off;
+    size_t i;
+
+    for (i = 0; i < AX25_SEG_RX_XFERS && !x; i++)
+    {
+        if (!r->xfers[i].in_use)
+        {
+            x = &r->xfers[i];
+        }
+    }
+    if (!x || ax25_seg_rx_alloc(r, size, &off) != 0)
+    {
+        return NULL;
+    }
+    memset(x, 0, sizeof(*x));
+    x->off = off;
+    x->size = size;
+    x->xfer_id = xfer_id;
+    x->seg_count = seg_count;
+    x->in_use = 1;
+    memset(ax25_seg_bitmap(r, x), 0, (seg_count + 7) / 8);
+    return x;
+}
+
+/*
+ * Learns the segment length from the first segment that is not the last
+ * one, moves a parked last segment to its place and gives the room
+ * reserved for longer segments back
+ */
+static int ax25_seg_rx_set_len(ax25_seg_rx_t *r, ax25_seg_xfer_t *x, uint16_t seg_len)
+{
+    uint8_t *data = ax25_seg_data(r, x);
+
+    if (x->last_parked)
+    {
+        if (x->last_len > seg_len)
+        {
+            return -1;
+        }
+        memmove(data + (size_t)(x->seg_count - 1) * seg_len, data + AX25_SEG_PARK(x), x->last_len);
+        x->last_parked = 0;
+    }
+    x->seg_len = seg_len;
+    x->size = (x->seg_count + 7) / 8 + (size_t)x->seg_count * seg_len;
+    return 0;
+}
+
+/**
+ * Prepares a reassembler
+ * @param r the reassembler
+ * @param slab storage for all the transfers in progress. A transfer of n
+ * segments takes (n + 7) / 8 + n * AX25_SEG_MAX_DATA bytes until its
+ * segment length is known, (n + 7) / 8 + n * seg_len bytes afterwards
+ * @param slab_cap size of slab
+ * @param on_complete called for every complete transfer
+ * @param user opaque pointer passed to on_complete
+ */
+void ax25_seg_rx_init(ax25_seg_rx_t *r, uint8_t *slab, size_t slab_cap, ax25_seg_rx_cb_t on_complete, void *user)
+{
+    memset(r, 0, sizeof(*r));
+    r->slab = slab;
+    r->slab_cap = slab_cap;
+    r->on_complete = on_complete;
+    r->user = user;
+}
+
+/**
+ * Files the segment carried by the info field of a frame
+ * @param r the reassembler
+ * @param info the info field, starting with the segment header
+ * @param len length of info
+ */
+void ax25_seg_rx_segment(ax25_seg_rx_t *r, const uint8_t *info, size_t len)
+{
+    ax25_seg_xfer_t *x;
+    uint16_t xfer_id;
+    uint16_t idx;
+    uint16_t count;
+    uint8_t *bitmap;
+    size_t place;
+
+    if (len < AX25_SEG_HDR_LEN)
+    {
+        r->dropped++;
+        return;
+    }
+    xfer_id = ((uint16_t)info[0] << 8) | info[1];
+    idx = ((uint16_t)info[2] << 8) | info[3];
+    count = ((uint16_t)info[4] << 8) | info[5];
+    info += AX25_SEG_HDR_LEN;
+    len -= AX25_SEG_HDR_LEN;
+
+    x = ax25_seg_rx_find(r, xfer_id);
+    if (!x && idx < count)
+    {
+        x = ax25_seg_rx_open(r, xfer_id, count);
+    }
+    if (!x || idx >= x->seg_count || count != x->seg_count || len > AX25_SEG_MAX_DATA)
+    {
+        r->dropped++;
+        return;
+    }
+    bitmap = ax25_seg_bitmap(r, x);
+    if (x->complete || bitmap[idx / 8] & (1 << (idx % 8)))
+    {
+        return;
+    }
+
+    if (idx < count - 1)
+    {
+        if (len == 0 || (x->seg_len == 0 && ax25_seg_rx_set_len(r, x, (uint16_t)len) != 0) || len != x->seg_len)
+        {
+            r->dropped++;
+            return;
+        }
+        place = (size_t)idx * x->seg_len;
+    }
+    else
+    {
+        if (x->seg_len && len > x->seg_len)
+        {
+            r->dropped++;
+            return;
+        }
+        x->last_len = (uint16_t)len;
+        x->last_parked = x->seg_len == 0;
+        place = x->seg_len ? (size_t)idx * x->seg_len : AX25_SEG_PARK(x);
+    }
+    memcpy(ax25_seg_data(r, x) + place, info, len);
+    bitmap[idx / 8] |= 1 << (idx % 8);
+
+    if (++x->received == x->seg_count)
+    {
+        x->complete = 1;
+        if (r->on_complete)
+        {
+            r->on_complete(r->user, x->xfer_id, ax25_seg_data(r, x), (size_t)(x->seg_count - 1) * x->seg_len + x->last_len);
+        }
+    }
+}
+
+/**
+ * Files the segment of a decoded UI frame. Matches ax25_rx_frame_cb_t, so
+ * the reassembler can be given to ax25_rx_init() directly.
+ * @param user the reassembler
+ * @param frame the frame without the FCS
+ * @param len length of frame
+ */
+void ax25_seg_rx_frame(void *user, const uint8_t *frame, size_t len)
+{
+    ax25_seg_rx_t *r = user;
+    ax25_ctrl_info_t info;
+
+    if (ax25_parse_ctrl(frame, len, 0, &info) != AX25_DEC_OK || info.type != AX25_UI_FRAME)
+    {
+        return;
+    }
+    ax25_seg_rx_segment(r, frame + info.info_off, len - info.info_off);
+}
+
+/**
+ * Lists the segments of a transfer still missing, as a compact request for
+ * selective retransmission: the transfer ID, then (first segment, number
+ * of segments) ranges, all big endian 16-bit values. Lists longer than
+ * out_cap are cut to the first ranges.
+ * @param r the reassembler
+ * @param xfer_id the transfer
+ * @param out receives the list
+ * @param out_cap size of out
+ * @return the number of bytes written to out, 0 if the transfer is unknown
+ */
+size_t ax25_seg_rx_missing(const ax25_seg_rx_t *r, uint16_t xfer_id, uint8_t *out, size_t out_cap)
+{
+    const ax25_seg_xfer_t *x = ax25_seg_rx_find(r, xfer_id);
+    const uint8_t *bitmap;
+    size_t n = 0;
+    uint32_t first;
+    uint32_t i;
+
+    if (!x || out_cap < 2)
+    {
+        return 0;
+    }
+    bitmap = ax25_seg_bitmap(r, x);
+    out[n++] = (xfer_id >> 8) & 0xFF;
+    out[n++] = xfer_id & 0xFF;
+    for (i = 0; i < x->seg_count && n + 4 <= out_cap;)
+    {
+        if (bitmap[i / 8] == 0xFF && i % 8 == 0)
+        {
+            i += 8;
+            continue;
+        }
+        if (bitmap[i / 8] & (1 << (i % 8)))
+        {
+            i++;
+            continue;
+        }
+        first = i;
+        while (i < x->seg_count && !(bitmap[i / 8] & (1 << (i % 8))))
+        {
+            i++;
+        }
+        out[n++] = (first >> 8) & 0xFF;
+        out[n++] = first & 0xFF;
+        out[n++] = ((i - first) >> 8) & 0xFF;
+        out[n++] = (i - first) & 0xFF;
+    }
+    return n;
+}
+
+/**
+ * Frees the slab region of a transfer, complete or not. The payload handed
+ * to the completion callback is no longer valid afterwards.
+ * @param r the reassembler
+ * @param xfer_id the transfer
+ */
+void ax25_seg_rx_release(ax25_seg_rx_t *r, uint16_t xfer_id)
+{
+    ax25_seg_xfer_t *x = ax25_seg_rx_find(r, xfer_id);
+
+    if (x)
+    {
+        x->in_use = 0;
+    }
+}
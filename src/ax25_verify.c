@@ -0,0 +1,97 @@
+#include "ax25_verify.h"
+
+/**
+ * A chunk of the buffer, hashed by one thread
+ */
+typedef struct
+{
+  const uint8_t *base;
+  size_t len;
+  uint16_t crc;
+} ax25_verify_chunk_t;
+
+static void *ax25_verify_worker(void *arg)
+{
+    ax25_verify_chunk_t *c = arg;
+
+    c->crc = ax25_fcs_update(0xFFFF, c->base, c->len) ^ 0xFFFF;
+    return NULL;
+}
+
+/**
+ * Computes the CRC-16/X.25 of a large buffer, e.g. a reassembled transfer
+ * or a capture file, on several threads. Each thread hashes a chunk with
+ * the FCS backend and the chunk CRCs are merged with crc16_combine().
+ * @param buf the data
+ * @param len length of buf
+ * @param nthreads threads to use, up to AX25_VERIFY_MAX_THREADS. Fewer
+ * are started for buffers under nthreads * AX25_VERIFY_MIN_CHUNK bytes
+ * @return the CRC, the same as crc16_ccitt_reversed(buf, len)
+ */
+uint16_t ax25_crc16_parallel(const uint8_t *buf, size_t len, size_t nthreads)
+{
+    ax25_verify_chunk_t chunks[AX25_VERIFY_MAX_THREADS];
+    pthread_t threads[AX25_VERIFY_MAX_THREADS];
+    uint8_t started[AX25_VERIFY_MAX_THREADS];
+    size_t chunk_len;
+    size_t off = 0;
+    uint16_t crc;
+    size_t i;
+
+    if (nthreads > AX25_VERIFY_MAX_THREADS)
+    {
+        nthreads = AX25_VERIFY_MAX_THREADS;
+    }
+    if (nthreads > len / AX25_VERIFY_MIN_CHUNK)
+    {
+        nthreads = len / AX25_VERIFY_MIN_CHUNK;
+    }
+    if (nthreads < 2)
+    {
+        return ax25_fcs_update(0xFFFF, buf, len) ^ 0xFFFF;
+    }
+
+    /* Detected before the workers can race to it */
+    ax25_cpu_features();
+    chunk_len = len / nthreads;
+    for (i = 0; i < nthreads; i++)
+    {
+        chunks[i].base = buf + off;
+        chunks[i].len = (i + 1 == nthreads) ? len - off : chunk_len;
+        off += chunks[i].len;
+    }
+    /* The first chunk is ours; chunks without a thread are done inline */
+    for (i = 1; i < nthreads; i++)
+    {
+        started[i] = pthread_create(&threads[i], NULL, ax25_verify_worker, &chunks[i]) == 0;
+    }
+    ax25_verify_worker(&chunks[0]);
+    crc = chunks[0].crc;
+    for (i = 1; i < nthreads; i++)
+    {
+        if (started[i])
+        {
+            pthread_join(threads[i], NULL);
+        }
+        else
+        {
+            ax25_verify_worker(&chunks[i]);
+        }
+        crc = crc16_combine(crc, chunks[i].crc, chunks[i].len);
+    }
+    return crc;
+}
+
+/**
+ * Checks a large buffer against its expected CRC-16/X.25, see
+ * ax25_crc16_parallel()
+ * @param buf the data
+ * @param len length of buf
+ * @param expected the expected CRC
+ * @param nthreads threads to use
+ * @return AX25_DEC_OK if the CRC matches
+ */
+ax25_decode_status_t ax25_verify_crc16(const uint8_t *buf, size_t len, uint16_t expected, size_t nthreads)
+{
+    return ax25_crc16_parallel(buf, len, nthreads) == expected ? AX25_DEC_OK : AX25_DEC_FAIL;
+}
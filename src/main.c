@@ -1,50 +1,56 @@
 #include <stdio.h>
 #include "ax25.h"
+#include "ax25_seg.h"
+
+/* Prints the payload once every segment is in */
+static void on_complete(void *user, uint16_t xfer_id, const uint8_t *data, size_t len)
+{
+    (void)user;
+    printf("\n decoded transfer %u, %zu bytes : ", xfer_id, len);
+    for (size_t j = 0; j < len; j++)
+    {
+        printf("%c", data[j]);
+    }
+}
 
 int main()
 {
-    uint8_t payload[] = "hello from parikshit";
+    uint8_t payload[600];
     size_t plen = sizeof(payload);
-    int no_of_frames = 1;
+    static uint8_t slab[4096];
+    ax25_enc_ctx_t ctx;
+    ax25_rx_ctx_t rx;
+    ax25_seg_rx_t seg_rx;
 
-    if (plen > AX25_MAX_FRAME_LEN)
+    for (size_t i = 0; i < plen; i++)
     {
-        no_of_frames = plen / AX25_MAX_FRAME_LEN + 1;
+        payload[i] = 'a' + i % 26;
     }
 
-    uint8_t **fin = (uint8_t **)malloc(AX25_MAX_FRAME_LEN * no_of_frames);
-    uint8_t **fout = (uint8_t **)malloc(AX25_MAX_FRAME_LEN * no_of_frames);
-
-    /*
-    uint8_t frame[AX25_MAX_FRAME_LEN]={0};
-    uint8_t outframe[AX25_MAX_FRAME_LEN]={0};
-*/
+    ax25_enc_init(&ctx, (const uint8_t *)GRD_CALLSIGN, GRD_SSID, (const uint8_t *)SAT_CALLSIGN, SAT_SSID);
 
-    for (int i = 0; i < no_of_frames; i++)
+    size_t cap = ax25_seg_encoded_size_max(plen, AX25_SEG_MAX_DATA);
+    uint8_t *fin = (uint8_t *)malloc(cap);
+    if (!fin)
     {
-        uint32_t len = ax25_encode(fin[i], payload, plen, AX25_UI_FRAME);
-
-        printf("\n encoded frame ");
-        if (len == 0)
-            printf("error");
-        for (int j = 0; j < len; j++)
-        {
-            printf("\n %x : %c : %d", *((fin + i) + j), *((fin + i) + j), *((fin + i) + j));
-        }
+        return 1;
     }
 
-    for (int i = 0; i < no_of_frames; i++)
+    int32_t len = ax25_seg_encode(&ctx, fin, cap, 1, payload, plen, AX25_SEG_MAX_DATA);
+    printf("\n encoded %zu bytes into %d bytes, %zu frames", plen, len, ax25_seg_count(plen, AX25_SEG_MAX_DATA));
+    if (len < 0)
     {
-        uint32_t outlen = ax25_recv(fout[i], fin[i], sizeof(fin[i]));
-
-        printf("\n decoded frame ");
-        if (outlen == 0)
-            printf("error");
-        for (int j = 0; j < outlen; j++)
-        {
-            printf("\n %x : %c : %d", *((fin + i) + j), *((fin + i) + j), *((fin + i) + j));
-        }
+        printf(" error\n");
+        free(fin);
+        return 1;
     }
 
+    ax25_seg_rx_init(&seg_rx, slab, sizeof(slab), on_complete, NULL);
+    ax25_rx_init(&rx, ax25_seg_rx_frame, &seg_rx);
+    ax25_rx_push(&rx, fin, len);
+    ax25_seg_rx_release(&seg_rx, 1);
+    printf("\n");
+
+    free(fin);
     return 0;
-}
\ No newline at end of file
+}
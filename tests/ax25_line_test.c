@@ -0,0 +1,117 @@
+/*
+ * Line coding of back-to-back frames: every frame must decode when frames
+ * are pushed one after the other into a single receiver, or after noise.
+ * Frames are coded either one-shot, from a reset coder each, or through
+ * one coder carried by the transmitter. Exits with 1 on a failure.
+ *
+ *   gcc -Iinclude tests/ax25_line_test.c src/ax25.c src/ax25_fcs.c src/ax25_scan.c -o ax25_line_test
+ *   ./ax25_line_test
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include "ax25.h"
+
+#define NFRAMES 50
+#define NTRIALS 200
+#define NOISE_LEN 20
+#define INFO_LEN 40
+
+static const uint8_t lines[] = { AX25_LINE_NRZI, AX25_LINE_G3RUH, AX25_LINE_NRZI | AX25_LINE_G3RUH };
+static uint8_t stream[NOISE_LEN + NFRAMES * AX25_ENCODED_SIZE_MAX(INFO_LEN)];
+static size_t frames;
+
+static void on_frame(void *user, const uint8_t *frame, size_t len)
+{
+    (void)frame;
+    (void)len;
+    (void)user;
+    frames++;
+}
+
+/* Decodes stream with a fresh receiver, returns the frames found */
+static size_t decode(uint8_t line, size_t len)
+{
+    ax25_rx_ctx_t rx;
+
+    ax25_rx_init(&rx, on_frame, NULL);
+    ax25_rx_set_line_coding(&rx, line);
+    frames = 0;
+    ax25_rx_push(&rx, stream, len);
+    return frames;
+}
+
+/*
+ * Encodes n frames into stream after its first head bytes, each coded by
+ * coder if not NULL
+ * @return the length of stream
+ */
+static size_t encode(const ax25_enc_ctx_t *ctx, ax25_line_coder_t *coder, size_t head, size_t n)
+{
+    uint8_t info[INFO_LEN];
+    size_t len = head;
+    int32_t ret;
+    size_t i;
+
+    for (i = 0; i < sizeof(info); i++)
+    {
+        info[i] = (uint8_t)rand();
+    }
+    for (i = 0; i < n; i++)
+    {
+        ret = ax25_encode_into(ctx, stream + len, sizeof(stream) - len, info, sizeof(info), AX25_UI_FRAME);
+        if (ret < 0)
+        {
+            return 0;
+        }
+        if (coder)
+        {
+            ax25_line_code(coder, stream + len, stream + len, (size_t)ret);
+        }
+        len += (size_t)ret;
+    }
+    return len;
+}
+
+int main(void)
+{
+    ax25_enc_ctx_t ctx;
+    ax25_enc_ctx_t plain;
+    ax25_line_coder_t coder;
+    size_t ok;
+    size_t i;
+    size_t t;
+    size_t j;
+    int fail = 0;
+
+    ax25_enc_init(&ctx, (const uint8_t *)GRD_CALLSIGN, GRD_SSID, (const uint8_t *)SAT_CALLSIGN, SAT_SSID);
+    plain = ctx;
+    for (i = 0; i < sizeof(lines); i++)
+    {
+        ax25_enc_set_line_coding(&ctx, lines[i]);
+
+        /* One-shot frames, each coded from a reset coder */
+        ok = decode(lines[i], encode(&ctx, NULL, 0, NFRAMES));
+        printf("line %u one-shot back to back: %zu/%d\n", lines[i], ok, NFRAMES);
+        fail |= ok != NFRAMES;
+
+        for (ok = 0, t = 0; t < NTRIALS; t++)
+        {
+            for (j = 0; j < NOISE_LEN; j++)
+            {
+                stream[j] = (uint8_t)rand();
+            }
+            ok += decode(lines[i], encode(&ctx, NULL, NOISE_LEN, 1));
+        }
+        printf("line %u one-shot after noise: %zu/%d\n", lines[i], ok, NTRIALS);
+        fail |= ok != NTRIALS;
+
+        /* Frames coded by one transmitter coder, after its sync flags only */
+        ax25_line_init(&coder, lines[i]);
+        memset(stream, AX25_FLAG, AX25_LINE_SYNC_MAX);
+        ax25_line_code(&coder, stream, stream, AX25_LINE_SYNC_MAX);
+        ok = decode(lines[i], encode(&plain, &coder, AX25_LINE_SYNC_MAX, NFRAMES));
+        printf("line %u carried coder back to back: %zu/%d\n", lines[i], ok, NFRAMES);
+        fail |= ok != NFRAMES;
+    }
+    return fail;
+}
@@ -0,0 +1,495 @@
+/*
+ * Throughput benchmark of the encoder, the decoders and the FCS, for
+ * payloads of 1 to 256 bytes of random data and of 0xFF (the most bit
+ * stuffing). Each case also reports the stack depth of one call and the
+ * heap allocations it makes. Build once per backend combination:
+ *
+ *   gcc -O2 -Iinclude -DAX25_FCS_BACKEND=AX25_FCS_SLICE8 -DAX25_SCAN_BACKEND=AX25_SCAN_SIMD \
+ *       tools/ax25_bench.c src/ax25.c src/ax25_fcs.c src/ax25_scan.c -lpthread \
+ *       -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc,--wrap=free -o ax25_bench
+ *   ./ax25_bench [-m ms] [-o results.csv] [-c baseline.csv] [-t tolerance %]
+ *
+ * bits/s counts the input of the function: payload bits for the encoders
+ * and the FCS, line bits for the decoders. With -c, a case slower than the
+ * baseline by more than the tolerance, or using more stack or allocations,
+ * is reported and the exit status is 1.
+ */
+#include <pthread.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ax25.h"
+
+/* Bytes of concatenated frames fed to the streaming decoders */
+#define BENCH_STREAM_LEN (64 * 1024)
+
+/* Stack given to the thread measuring the stack depth */
+#define BENCH_STACK_LEN (256 * 1024)
+#define BENCH_STACK_FILL 0xA5
+
+#define BENCH_MAX_CASES 128
+
+static const size_t bench_lens[] = { 1, 16, 64, 128, 256 };
+
+#if AX25_FCS_BACKEND == AX25_FCS_TABLE
+#define BENCH_FCS_NAME "table"
+#elif AX25_FCS_BACKEND == AX25_FCS_SLICE4
+#define BENCH_FCS_NAME "slice4"
+#elif AX25_FCS_BACKEND == AX25_FCS_SLICE8
+#define BENCH_FCS_NAME "slice8"
+#elif AX25_FCS_BACKEND == AX25_FCS_CLMUL
+#define BENCH_FCS_NAME "clmul"
+#else
+#define BENCH_FCS_NAME "stm32"
+#endif
+
+#if AX25_SCAN_BACKEND == AX25_SCAN_SIMD
+#define BENCH_SCAN_NAME "simd"
+#else
+#define BENCH_SCAN_NAME "scalar"
+#endif
+
+/*
+ * Allocation counting, through the linker's --wrap: the library calls land
+ * here and are forwarded to the C library
+ */
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t n, size_t size);
+void *__real_realloc(void *p, size_t size);
+void __real_free(void *p);
+
+static volatile size_t bench_allocs;
+
+void *__wrap_malloc(size_t size)
+{
+    bench_allocs++;
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t n, size_t size)
+{
+    bench_allocs++;
+    return __real_calloc(n, size);
+}
+
+void *__wrap_realloc(void *p, size_t size)
+{
+    bench_allocs++;
+    return __real_realloc(p, size);
+}
+
+void __wrap_free(void *p)
+{
+    __real_free(p);
+}
+
+/**
+ * Inputs of one payload length and pattern, shared by every function
+ */
+typedef struct
+{
+  uint8_t payload[AX25_MAX_FRAME_LEN];
+  size_t len;
+  uint8_t enc[AX25_MAX_ENCODED_LEN];      //!< the payload as one encoded UI frame
+  size_t enc_len;
+  uint8_t *stream;                        //!< enc repeated
+  size_t stream_len;
+  size_t stream_frames;
+  ax25_frame_desc_t *descs;               //!< room for ax25_decode_batch()
+  uint8_t *arena;
+  size_t arena_len;
+  uint8_t out[AX25_MAX_ENCODED_LEN];
+  ax25_enc_ctx_t ctx;
+  ax25_deframer_t deframer;
+} bench_input_t;
+
+/*
+ * Runs the function once
+ * @return frames processed; *bits receives the input bits
+ */
+typedef size_t (*bench_fn_t)(bench_input_t *in, uint64_t *bits);
+
+typedef struct
+{
+  const char *name;
+  bench_fn_t fn;
+} bench_func_t;
+
+/**
+ * Result of one case
+ */
+typedef struct
+{
+  char name[32];
+  char pattern[8];
+  size_t len;
+  double frames_per_s;
+  double bits_per_s;
+  size_t stack;         //!< deepest stack use of one call, bytes
+  size_t allocs;        //!< heap allocations of one call
+} bench_result_t;
+
+static volatile size_t bench_sink;
+
+static size_t bench_encode(bench_input_t *in, uint64_t *bits)
+{
+    *bits = 8 * (uint64_t)in->len;
+    bench_sink += (size_t)ax25_encode(in->out, in->payload, in->len, AX25_UI_FRAME);
+    return 1;
+}
+
+static size_t bench_encode_into(bench_input_t *in, uint64_t *bits)
+{
+    *bits = 8 * (uint64_t)in->len;
+    bench_sink += (size_t)ax25_encode_into(&in->ctx, in->out, sizeof(in->out), in->payload, in->len, AX25_UI_FRAME);
+    return 1;
+}
+
+static size_t bench_fcs(bench_input_t *in, uint64_t *bits)
+{
+    *bits = 8 * (uint64_t)in->len;
+    bench_sink += ax25_fcs(in->payload, in->len);
+    return 1;
+}
+
+static size_t bench_recv(bench_input_t *in, uint64_t *bits)
+{
+    *bits = 8 * (uint64_t)in->enc_len;
+    bench_sink += ax25_recv(in->out, in->enc, in->enc_len);
+    return 1;
+}
+
+static size_t bench_deframer(bench_input_t *in, uint64_t *bits)
+{
+    ax25_deframer_t *d = &in->deframer;
+    size_t frames = 0;
+    size_t pos = 0;
+
+    *bits = 8 * (uint64_t)in->stream_len;
+    while (pos < in->stream_len)
+    {
+        pos += ax25_deframer_push(d, in->stream + pos, in->stream_len - pos);
+        frames += d->frame_ready && d->fcs_ok;
+    }
+    return frames;
+}
+
+static size_t bench_decode_batch(bench_input_t *in, uint64_t *bits)
+{
+    size_t n;
+    size_t frames = 0;
+    size_t i;
+
+    *bits = 8 * (uint64_t)in->stream_len;
+    n = ax25_decode_batch(in->descs, in->stream_frames + 1, in->arena, in->arena_len, in->stream, in->stream_len);
+    for (i = 0; i < n; i++)
+    {
+        frames += in->descs[i].status == AX25_DEC_OK;
+    }
+    return frames;
+}
+
+static size_t bench_flag_scan(bench_input_t *in, uint64_t *bits)
+{
+    size_t frames = 0;
+    size_t pos = 0;
+    size_t n;
+
+    *bits = 8 * (uint64_t)in->stream_len;
+    while (pos < in->stream_len)
+    {
+        n = ax25_flag_scan(in->stream + pos, in->stream_len - pos, 0);
+        pos += n ? n : 1;
+        frames++;
+    }
+    /* Two flags per frame */
+    return frames / 2;
+}
+
+static const bench_func_t bench_funcs[] =
+  {
+    { "ax25_encode", bench_encode },
+    { "ax25_encode_into", bench_encode_into },
+    { "ax25_fcs", bench_fcs },
+    { "ax25_recv", bench_recv },
+    { "ax25_deframer_push", bench_deframer },
+    { "ax25_decode_batch", bench_decode_batch },
+    { "ax25_flag_scan", bench_flag_scan },
+  };
+
+static double bench_now(void)
+{
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+static int bench_input_init(bench_input_t *in, size_t len, int worst)
+{
+    size_t i;
+
+    memset(in, 0, sizeof(*in));
+    for (i = 0; i < len; i++)
+    {
+        in->payload[i] = worst ? 0xFF : (uint8_t)rand();
+    }
+    in->len = len;
+    ax25_enc_init(&in->ctx, (const uint8_t *)GRD_CALLSIGN, GRD_SSID, (const uint8_t *)SAT_CALLSIGN, SAT_SSID);
+    in->enc_len = (size_t)ax25_encode_into(&in->ctx, in->enc, sizeof(in->enc), in->payload, len, AX25_UI_FRAME);
+
+    in->stream_frames = BENCH_STREAM_LEN / in->enc_len;
+    in->stream_len = in->stream_frames * in->enc_len;
+    in->arena_len = in->stream_frames * AX25_MAX_RAW_FRAME_LEN;
+    in->stream = malloc(in->stream_len);
+    in->descs = malloc((in->stream_frames + 1) * sizeof(*in->descs));
+    in->arena = malloc(in->arena_len);
+    if (!in->stream || !in->descs || !in->arena)
+    {
+        return -1;
+    }
+    for (i = 0; i < in->stream_frames; i++)
+    {
+        memcpy(in->stream + i * in->enc_len, in->enc, in->enc_len);
+    }
+    ax25_deframer_init(&in->deframer, in->out, AX25_MAX_RAW_FRAME_LEN);
+    return 0;
+}
+
+static void bench_input_free(bench_input_t *in)
+{
+    free(in->stream);
+    free(in->descs);
+    free(in->arena);
+}
+
+typedef struct
+{
+  bench_fn_t fn;
+  bench_input_t *in;
+} bench_probe_t;
+
+static void *bench_probe_run(void *arg)
+{
+    bench_probe_t *p = arg;
+    uint64_t bits;
+
+    if (p->fn)
+    {
+        p->fn(p->in, &bits);
+    }
+    return NULL;
+}
+
+/*
+ * Runs fn once on a thread whose stack is filled with a pattern, and finds
+ * the lowest byte overwritten
+ * @return bytes of stack used, thread start up included
+ */
+static size_t bench_stack_probe(bench_fn_t fn, bench_input_t *in)
+{
+    static uint8_t stack[BENCH_STACK_LEN] __attribute__((aligned(4096)));
+    bench_probe_t p = { fn, in };
+    pthread_attr_t attr;
+    pthread_t t;
+    size_t i;
+
+    memset(stack, BENCH_STACK_FILL, sizeof(stack));
+    pthread_attr_init(&attr);
+    pthread_attr_setstack(&attr, stack, sizeof(stack));
+    if (pthread_create(&t, &attr, bench_probe_run, &p) != 0)
+    {
+        pthread_attr_destroy(&attr);
+        return 0;
+    }
+    pthread_join(t, NULL);
+    pthread_attr_destroy(&attr);
+    for (i = 0; i < sizeof(stack) && stack[i] == BENCH_STACK_FILL; i++)
+    {
+    }
+    return sizeof(stack) - i;
+}
+
+/*
+ * Times fn over batches of doubling size until a batch lasts min_time
+ */
+static void bench_run(const bench_func_t *f, bench_input_t *in, double min_time, size_t stack_base, bench_result_t *r)
+{
+    size_t batch = 1;
+    size_t frames;
+    uint64_t bits;
+    uint64_t total_bits;
+    double t0;
+    double dt;
+    size_t i;
+
+    bench_allocs = 0;
+    f->fn(in, &bits);
+    r->allocs = bench_allocs;
+    r->stack = bench_stack_probe(f->fn, in);
+    r->stack = r->stack > stack_base ? r->stack - stack_base : 0;
+
+    for (;;)
+    {
+        frames = 0;
+        total_bits = 0;
+        t0 = bench_now();
+        for (i = 0; i < batch; i++)
+        {
+            frames += f->fn(in, &bits);
+            total_bits += bits;
+        }
+        dt = bench_now() - t0;
+        if (dt >= min_time)
+        {
+            break;
+        }
+        batch *= 2;
+    }
+    r->frames_per_s = frames / dt;
+    r->bits_per_s = total_bits / dt;
+}
+
+static void bench_write_csv(FILE *f, const bench_result_t *r, size_t n)
+{
+    size_t i;
+
+    fprintf(f, "function,pattern,len,fcs_backend,scan_backend,frames_per_s,bits_per_s,stack_bytes,allocs\n");
+    for (i = 0; i < n; i++)
+    {
+        fprintf(f, "%s,%s,%zu,%s,%s,%.0f,%.0f,%zu,%zu\n", r[i].name, r[i].pattern, r[i].len,
+                BENCH_FCS_NAME, BENCH_SCAN_NAME, r[i].frames_per_s, r[i].bits_per_s, r[i].stack, r[i].allocs);
+    }
+}
+
+/*
+ * Compares the results with a CSV written by an earlier run
+ * @return the number of regressions
+ */
+static size_t bench_compare(const char *path, const bench_result_t *r, size_t n, double tolerance)
+{
+    char line[256];
+    char name[32];
+    char pattern[8];
+    size_t len;
+    double fps;
+    double bps;
+    size_t stack;
+    size_t allocs;
+    size_t regressions = 0;
+    size_t i;
+    FILE *f = fopen(path, "r");
+
+    if (!f)
+    {
+        perror(path);
+        return 1;
+    }
+    while (fgets(line, sizeof(line), f))
+    {
+        if (sscanf(line, "%31[^,],%7[^,],%zu,%*[^,],%*[^,],%lf,%lf,%zu,%zu", name, pattern, &len, &fps, &bps, &stack, &allocs) != 7)
+        {
+            continue;
+        }
+        for (i = 0; i < n; i++)
+        {
+            if (strcmp(r[i].name, name) || strcmp(r[i].pattern, pattern) || r[i].len != len)
+            {
+                continue;
+            }
+            if (r[i].frames_per_s < fps * (1 - tolerance / 100) || r[i].stack > stack || r[i].allocs > allocs)
+            {
+                fprintf(stderr, "regression: %s %s %zu: %.0f frames/s (was %.0f), stack %zu (was %zu), allocs %zu (was %zu)\n",
+                        name, pattern, len, r[i].frames_per_s, fps, r[i].stack, stack, r[i].allocs, allocs);
+                regressions++;
+            }
+        }
+    }
+    fclose(f);
+    return regressions;
+}
+
+int main(int argc, char **argv)
+{
+    static bench_input_t in;
+    static bench_result_t results[BENCH_MAX_CASES];
+    const char *out_path = NULL;
+    const char *baseline = NULL;
+    double min_time = 0.2;
+    double tolerance = 10;
+    size_t stack_base;
+    size_t nresults = 0;
+    size_t l;
+    size_t f;
+    int worst;
+    int c;
+    FILE *out;
+
+    while ((c = getopt(argc, argv, "m:o:c:t:")) != -1)
+    {
+        switch (c)
+        {
+        case 'm':
+            min_time = atof(optarg) / 1000;
+            break;
+        case 'o':
+            out_path = optarg;
+            break;
+        case 'c':
+            baseline = optarg;
+            break;
+        case 't':
+            tolerance = atof(optarg);
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-m ms] [-o results.csv] [-c baseline.csv] [-t tolerance %%]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    srand(1);
+    stack_base = bench_stack_probe(NULL, &in);
+    printf("fcs backend %s, scan backend %s\n", BENCH_FCS_NAME, BENCH_SCAN_NAME);
+    printf("%-20s %-7s %4s %14s %12s %8s %7s\n", "function", "pattern", "len", "frames/s", "Mbit/s", "stack", "allocs");
+    for (worst = 0; worst < 2; worst++)
+    {
+        for (l = 0; l < sizeof(bench_lens) / sizeof(bench_lens[0]); l++)
+        {
+            if (bench_input_init(&in, bench_lens[l], worst) < 0)
+            {
+                fprintf(stderr, "out of memory\n");
+                return 1;
+            }
+            for (f = 0; f < sizeof(bench_funcs) / sizeof(bench_funcs[0]) && nresults < BENCH_MAX_CASES; f++)
+            {
+                bench_result_t *r = &results[nresults++];
+
+                snprintf(r->name, sizeof(r->name), "%s", bench_funcs[f].name);
+                snprintf(r->pattern, sizeof(r->pattern), "%s", worst ? "ff" : "random");
+                r->len = bench_lens[l];
+                bench_run(&bench_funcs[f], &in, min_time, stack_base, r);
+                printf("%-20s %-7s %4zu %14.0f %12.2f %8zu %7zu\n", r->name, r->pattern, r->len,
+                       r->frames_per_s, r->bits_per_s / 1e6, r->stack, r->allocs);
+            }
+            bench_input_free(&in);
+        }
+    }
+
+    if (out_path)
+    {
+        out = fopen(out_path, "w");
+        if (!out)
+        {
+            perror(out_path);
+            return 1;
+        }
+        bench_write_csv(out, results, nresults);
+        fclose(out);
+    }
+    if (baseline && bench_compare(baseline, results, nresults, tolerance))
+    {
+        return 1;
+    }
+    return 0;
+}
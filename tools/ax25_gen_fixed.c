@@ -0,0 +1,64 @@
+/*
+ * Generates include/ax25_fixed.h: the constant prefix of the frames sent
+ * by ax25_encode(), from the callsigns of include/config.h. Run it again
+ * whenever config.h changes:
+ *
+ *   gcc -Iinclude tools/ax25_gen_fixed.c src/ax25.c src/ax25_fcs.c src/ax25_scan.c -o ax25_gen_fixed
+ *   ./ax25_gen_fixed > include/ax25_fixed.h
+ */
+#include <stdio.h>
+#include "ax25.h"
+
+static void print_bytes(const char *name, const uint8_t *b, size_t len)
+{
+    size_t i;
+
+    printf("static const uint8_t %s[%zu] =\n  {", name, len);
+    for (i = 0; i < len; i++)
+    {
+        printf("%s0x%02X", i ? (i % 8 ? ", " : ",\n    ") : " ", b[i]);
+    }
+    printf(" };\n");
+}
+
+int main(void)
+{
+    ax25_enc_ctx_t ctx;
+    ax25_stuffer_t s;
+    uint8_t hdr[AX25_MAX_ADDR_LEN + AX25_MAX_CTRL_LEN + 1];
+    uint8_t bits[AX25_ENCODED_SIZE_MAX(0)];
+    size_t hdr_len;
+
+    ax25_enc_init(&ctx, (const uint8_t *)GRD_CALLSIGN, GRD_SSID, (const uint8_t *)SAT_CALLSIGN, SAT_SSID);
+    memcpy(hdr, ctx.addr, ctx.addr_len);
+    hdr_len = ctx.addr_len;
+    hdr[hdr_len++] = AX25_CTRL_UI;
+    hdr[hdr_len++] = 0xF0;
+
+    /* Opening flag and header, stuffed, as the encoder would emit them */
+    ax25_stuffer_init(&s, bits, sizeof(bits));
+    ax25_stuffer_put_flag(&s);
+    ax25_stuffer_put(&s, hdr, hdr_len);
+
+    printf("/* Generated by tools/ax25_gen_fixed.c from include/config.h, do not edit */\n");
+    printf("#ifndef AX25_FIXED_H /* AX25_FIXED_H */\n#define AX25_FIXED_H\n\n");
+    printf("#include <stdint.h>\n\n");
+    printf("/* UI frames from %s-%u to %s-%u */\n", SAT_CALLSIGN, SAT_SSID, GRD_CALLSIGN, GRD_SSID);
+    printf("#define AX25_FIXED_SAT_CALL_%s 1\n", SAT_CALLSIGN);
+    printf("#define AX25_FIXED_SAT_SSID %u\n", SAT_SSID);
+    printf("#define AX25_FIXED_GRD_CALL_%s 1\n", GRD_CALLSIGN);
+    printf("#define AX25_FIXED_GRD_SSID %u\n\n", GRD_SSID);
+    printf("#define AX25_FIXED_HDR_LEN %zu\n", hdr_len);
+    print_bytes("ax25_fixed_hdr", hdr, hdr_len);
+    printf("\n/* FCS register after the header */\n");
+    printf("#define AX25_FIXED_HDR_FCS 0x%04X\n", ax25_fcs_update(0xFFFF, hdr, hdr_len));
+    printf("\n/*\n * Opening flag and stuffed header: whole bytes, then the bits left in\n");
+    printf(" * the stuffer accumulator and the run of 1's they end with\n */\n");
+    printf("#define AX25_FIXED_PREFIX_LEN %zu\n", s.out_idx);
+    print_bytes("ax25_fixed_prefix", bits, s.out_idx);
+    printf("#define AX25_FIXED_PREFIX_ACC 0x%02X\n", (unsigned)(s.acc & ((1U << s.acc_bits) - 1)));
+    printf("#define AX25_FIXED_PREFIX_ACC_BITS %u\n", s.acc_bits);
+    printf("#define AX25_FIXED_PREFIX_CONT_1 %u\n", s.cont_1);
+    printf("\n#endif /* AX25_FIXED_H */\n");
+    return 0;
+}
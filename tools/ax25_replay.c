@@ -0,0 +1,332 @@
+/*
+ * Replays a recorded bitstream through the streaming deframer and writes
+ * the decoded frames as KISS, pcap (LINKTYPE_AX25) or an indexed binary
+ * log. The capture is memory mapped and decoded in place.
+ *
+ *   gcc -O2 -Iinclude tools/ax25_replay.c src/ax25.c src/ax25_fcs.c src/ax25_scan.c -o ax25_replay
+ *   ./ax25_replay [-b] [-l nrzi|g3ruh|both] [-f kiss|pcap|log] [-r bitrate] [-o out] capture
+ *
+ * Binary log layout, little endian:
+ *   "AX25LOG1"
+ *   per frame: u64 bit offset of the closing flag, u16 length, u16 flags,
+ *              the frame without the FCS
+ *   index: u64 file offset of each frame record, u64 frame count, "AX25IDX1"
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ax25.h"
+
+#define REPLAY_KISS 0
+#define REPLAY_PCAP 1
+#define REPLAY_LOG  2
+
+#define KISS_FEND  0xC0
+#define KISS_FESC  0xDB
+#define KISS_TFEND 0xDC
+#define KISS_TFESC 0xDD
+
+#define PCAP_LINKTYPE_AX25 3
+
+/* Unpacked input is packed into this many bytes at a time */
+#define REPLAY_PACK_LEN 4096
+
+typedef struct
+{
+  FILE *out;
+  int format;
+  uint32_t bitrate;     //!< turns bit offsets into pcap timestamps
+  uint64_t *index;      //!< file offset of each log record
+  size_t nframes;
+  size_t index_cap;
+  uint64_t out_pos;     //!< bytes written to out
+  uint64_t bad_fcs;
+} replay_t;
+
+static void put_le(replay_t *r, uint64_t v, size_t n)
+{
+    uint8_t b[8];
+    size_t i;
+
+    for (i = 0; i < n; i++)
+    {
+        b[i] = (uint8_t)(v >> (8 * i));
+    }
+    fwrite(b, 1, n, r->out);
+    r->out_pos += n;
+}
+
+static void put_bytes(replay_t *r, const uint8_t *b, size_t n)
+{
+    fwrite(b, 1, n, r->out);
+    r->out_pos += n;
+}
+
+static void replay_begin(replay_t *r)
+{
+    if (r->format == REPLAY_PCAP)
+    {
+        put_le(r, 0xA1B2C3D4, 4);
+        put_le(r, 2, 2);
+        put_le(r, 4, 2);
+        put_le(r, 0, 4);
+        put_le(r, 0, 4);
+        put_le(r, 65535, 4);
+        put_le(r, PCAP_LINKTYPE_AX25, 4);
+    }
+    else if (r->format == REPLAY_LOG)
+    {
+        put_bytes(r, (const uint8_t *)"AX25LOG1", 8);
+    }
+}
+
+static int replay_frame(replay_t *r, const uint8_t *frame, size_t len, uint64_t bit_pos)
+{
+    uint64_t *index;
+    uint64_t usec;
+    size_t i;
+
+    switch (r->format)
+    {
+    case REPLAY_KISS:
+        putc(KISS_FEND, r->out);
+        putc(0x00, r->out);
+        for (i = 0; i < len; i++)
+        {
+            if (frame[i] == KISS_FEND || frame[i] == KISS_FESC)
+            {
+                putc(KISS_FESC, r->out);
+                putc(frame[i] == KISS_FEND ? KISS_TFEND : KISS_TFESC, r->out);
+            }
+            else
+            {
+                putc(frame[i], r->out);
+            }
+        }
+        putc(KISS_FEND, r->out);
+        break;
+    case REPLAY_PCAP:
+        usec = bit_pos * 1000000 / r->bitrate;
+        put_le(r, usec / 1000000, 4);
+        put_le(r, usec % 1000000, 4);
+        put_le(r, len, 4);
+        put_le(r, len, 4);
+        put_bytes(r, frame, len);
+        break;
+    default:
+        if (r->nframes == r->index_cap)
+        {
+            r->index_cap = r->index_cap ? 2 * r->index_cap : 1024;
+            index = realloc(r->index, r->index_cap * sizeof(*index));
+            if (!index)
+            {
+                return -1;
+            }
+            r->index = index;
+        }
+        r->index[r->nframes] = r->out_pos;
+        put_le(r, bit_pos, 8);
+        put_le(r, len, 2);
+        put_le(r, 0, 2);
+        put_bytes(r, frame, len);
+        break;
+    }
+    r->nframes++;
+    /* Catches a failed flush of the stdio buffer, e.g. a full disk */
+    return ferror(r->out) ? -1 : 0;
+}
+
+static void replay_end(replay_t *r)
+{
+    size_t i;
+
+    if (r->format != REPLAY_LOG)
+    {
+        return;
+    }
+    for (i = 0; i < r->nframes; i++)
+    {
+        put_le(r, r->index[i], 8);
+    }
+    put_le(r, r->nframes, 8);
+    put_bytes(r, (const uint8_t *)"AX25IDX1", 8);
+}
+
+/*
+ * Feeds packed bytes to the deframer and emits every frame with a good FCS
+ * @param bit_base bit offset of in within the capture
+ */
+static int replay_push(replay_t *r, ax25_deframer_t *d, const uint8_t *in, size_t len, uint64_t bit_base)
+{
+    size_t pos = 0;
+
+    do
+    {
+        pos += ax25_deframer_push(d, in + pos, len - pos);
+        if (!d->frame_ready)
+        {
+            continue;
+        }
+        if (!d->fcs_ok)
+        {
+            r->bad_fcs++;
+        }
+        else if (replay_frame(r, d->out, d->out_len - sizeof(uint16_t), bit_base + 8 * pos) < 0)
+        {
+            return -1;
+        }
+    } while (pos < len || d->frame_ready);
+    return 0;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "usage: %s [-b] [-l nrzi|g3ruh|both] [-f kiss|pcap|log] [-r bitrate] [-o out] capture\n"
+            "  -b  the capture holds one bit per byte, else packed bits, MS bit first.\n"
+            "      A last group of fewer than 8 bits is ignored\n", prog);
+}
+
+int main(int argc, char **argv)
+{
+    static uint8_t frame[AX25_MAX_RAW_FRAME_LEN];
+    uint8_t pack[REPLAY_PACK_LEN];
+    const char *out_path = NULL;
+    replay_t r;
+    ax25_deframer_t d;
+    struct timespec t0;
+    struct timespec t1;
+    struct stat st;
+    const uint8_t *in;
+    int unpacked = 0;
+    uint8_t line = AX25_LINE_NONE;
+    double secs;
+    size_t len;
+    size_t i;
+    size_t n;
+    int ret = 0;
+    int fd;
+    int c;
+
+    memset(&r, 0, sizeof(r));
+    r.format = REPLAY_KISS;
+    r.bitrate = 9600;
+    while ((c = getopt(argc, argv, "bl:f:r:o:")) != -1)
+    {
+        switch (c)
+        {
+        case 'b':
+            unpacked = 1;
+            break;
+        case 'l':
+            line = !strcmp(optarg, "nrzi") ? AX25_LINE_NRZI : !strcmp(optarg, "g3ruh") ? AX25_LINE_G3RUH
+                 : !strcmp(optarg, "both") ? AX25_LINE_NRZI | AX25_LINE_G3RUH : 0xFF;
+            break;
+        case 'f':
+            r.format = !strcmp(optarg, "kiss") ? REPLAY_KISS : !strcmp(optarg, "pcap") ? REPLAY_PCAP
+                     : !strcmp(optarg, "log") ? REPLAY_LOG : -1;
+            break;
+        case 'r':
+            r.bitrate = (uint32_t)strtoul(optarg, NULL, 10);
+            break;
+        case 'o':
+            out_path = optarg;
+            break;
+        default:
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (optind + 1 != argc || line == 0xFF || r.format < 0 || r.bitrate == 0)
+    {
+        usage(argv[0]);
+        return 2;
+    }
+
+    fd = open(argv[optind], O_RDONLY);
+    if (fd < 0 || fstat(fd, &st) < 0)
+    {
+        fprintf(stderr, "%s: %s\n", argv[optind], strerror(errno));
+        return 1;
+    }
+    len = (size_t)st.st_size;
+    in = len ? mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0) : NULL;
+    if (len && in == MAP_FAILED)
+    {
+        fprintf(stderr, "%s: %s\n", argv[optind], strerror(errno));
+        return 1;
+    }
+    if (len)
+    {
+        madvise((void *)in, len, MADV_SEQUENTIAL);
+    }
+
+    r.out = out_path ? fopen(out_path, "wb") : stdout;
+    if (!r.out)
+    {
+        fprintf(stderr, "%s: %s\n", out_path, strerror(errno));
+        return 1;
+    }
+    setvbuf(r.out, NULL, _IOFBF, 1 << 20);
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    ax25_deframer_init(&d, frame, sizeof(frame));
+    d.line = line;
+    replay_begin(&r);
+    if (!unpacked)
+    {
+        ret = replay_push(&r, &d, in, len, 0);
+    }
+    else
+    {
+        if (len % 8)
+        {
+            fprintf(stderr, "%s: ignoring the last %zu bits, not a whole byte\n", argv[optind], len % 8);
+        }
+        /* One bit per byte: pack into a small staging buffer */
+        for (i = 0; i < len / 8 && ret == 0; i += n)
+        {
+            n = len / 8 - i < REPLAY_PACK_LEN ? len / 8 - i : REPLAY_PACK_LEN;
+            for (size_t k = 0; k < n; k++)
+            {
+                const uint8_t *b = in + 8 * (i + k);
+
+                pack[k] = (uint8_t)((b[0] & 1) << 7 | (b[1] & 1) << 6 | (b[2] & 1) << 5 | (b[3] & 1) << 4
+                                    | (b[4] & 1) << 3 | (b[5] & 1) << 2 | (b[6] & 1) << 1 | (b[7] & 1));
+            }
+            ret = replay_push(&r, &d, pack, n, 8 * (uint64_t)i);
+        }
+    }
+    replay_end(&r);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    if (fflush(r.out) != 0 || ferror(r.out))
+    {
+        ret = -1;
+    }
+    if (out_path && fclose(r.out) != 0)
+    {
+        ret = -1;
+    }
+    if (ret < 0)
+    {
+        fprintf(stderr, "write failed\n");
+        ret = 1;
+    }
+    secs = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+    fprintf(stderr, "%zu frames, %llu with a bad FCS, %zu input bytes in %.3f s (%.1f MB/s)\n",
+            r.nframes, (unsigned long long)r.bad_fcs, len, secs, secs > 0 ? len / secs / 1e6 : 0.0);
+
+    if (len)
+    {
+        munmap((void *)in, len);
+    }
+    close(fd);
+    free(r.index);
+    return ret;
+}